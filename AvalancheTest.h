@@ -11,6 +11,7 @@
 
 #include "Types.h"
 #include "Random.h"
+#include "Results.h"
 
 #include <vector>
 #include <stdio.h>
@@ -77,6 +78,7 @@ bool AvalancheTest ( pfHash hash, const int reps )
   const int hashbits = hashbytes * 8;
 
   printf("Testing %3d-bit keys -> %3d-bit hashes, %8d reps",keybits,hashbits,reps);
+  ResultsSetTest("Avalanche","%d-bit keys, %d reps",keybits,reps);
 
   //----------
 
@@ -100,6 +102,11 @@ bool AvalancheTest ( pfHash hash, const int reps )
 
   printf("\n");
 
+  ResultBegin();
+  ResultDouble("worst_bias",b);
+  ResultBool("pass",result);
+  ResultEnd();
+
   return result;
 }
 
@@ -204,6 +211,8 @@ bool BicTest ( pfHash hash, const int reps )
   int maxA = 0;
   int maxB = 0;
 
+  ResultsSetTest("BIC","%d-bit keys, %d reps",keybits,reps);
+
   for(int i = 0; i < keybits; i++)
   {
     if(i % (keybits/10) == 0) printf(".");
@@ -228,6 +237,14 @@ bool BicTest ( pfHash hash, const int reps )
 
   bool result = (maxBias < 0.05);
 
+  ResultBegin();
+  ResultDouble("worst_bias",maxBias);
+  ResultInt("bias_key_bit",maxK);
+  ResultInt("bias_out_bit_a",maxA);
+  ResultInt("bias_out_bit_b",maxB);
+  ResultBool("pass",result);
+  ResultEnd();
+
   return result;
 }
 
@@ -256,6 +273,8 @@ void BicTest3 ( pfHash hash, const int reps, bool verbose = true )
 
   std::vector<int> bins(keybits*pagesize,0);
 
+  ResultsSetTest("BIC","%d-bit keys, %d reps",keybits,reps);
+
   for(int keybit = 0; keybit < keybits; keybit++)
   {
     if(keybit % (keybits/10) == 0) printf(".");
@@ -336,6 +355,13 @@ void BicTest3 ( pfHash hash, const int reps, bool verbose = true )
   }
 
   printf("Max bias %f - (%3d : %3d,%3d)\n",maxBias,maxK,maxA,maxB);
+
+  ResultBegin();
+  ResultDouble("worst_bias",maxBias);
+  ResultInt("bias_key_bit",maxK);
+  ResultInt("bias_out_bit_a",maxA);
+  ResultInt("bias_out_bit_b",maxB);
+  ResultEnd();
 }
 
 
@@ -361,6 +387,8 @@ void BicTest2 ( pfHash hash, const int reps, bool verbose = true )
   keytype key;
   hashtype h1,h2;
 
+  ResultsSetTest("BIC","%d-bit keys, %d reps",keybits,reps);
+
   for(int out1 = 0; out1 < hashbits-1; out1++)
   for(int out2 = out1+1; out2 < hashbits; out2++)
   {
@@ -417,6 +445,13 @@ void BicTest2 ( pfHash hash, const int reps, bool verbose = true )
   }
 
   printf("Max bias %f - (%3d : %3d,%3d)\n",maxBias,maxK,maxA,maxB);
+
+  ResultBegin();
+  ResultDouble("worst_bias",maxBias);
+  ResultInt("bias_key_bit",maxK);
+  ResultInt("bias_out_bit_a",maxA);
+  ResultInt("bias_out_bit_b",maxB);
+  ResultEnd();
 }
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,274 @@
+#include "Baseline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <map>
+#include <string>
+
+double g_baselineAlpha     = 0.01;
+double g_baselineMinChange = 0.05;
+
+//-----------------------------------------------------------------------------
+// Distributions are keyed by "hash test param", which is also how they're
+// written out - one line per distribution, followed by the exact minimum and
+// maximum and then the non-empty buckets as value:count pairs. Each bucket's
+// value is its midpoint, so a reloaded distribution isn't shifted towards
+// the bottom of its buckets; the exact extremes are put back as one sample
+// each in their buckets. Files without min= and max= still load.
+
+typedef std::map<std::string,Histogram> BaselineMap;
+
+static BaselineMap g_recorded;
+static std::string g_hashName = "unknown";
+
+static std::string BaselineKey ( const char * hash, const char * test, int param )
+{
+  char key[256];
+
+  snprintf(key,sizeof(key),"%s %s %d",hash,test,param);
+
+  return key;
+}
+
+void BaselineSetHash ( const char * name )
+{
+  g_hashName = name;
+}
+
+void BaselineRecord ( const char * test, int param, const Histogram & samples )
+{
+  g_recorded[BaselineKey(g_hashName.c_str(),test,param)] = samples;
+}
+
+//----------
+
+static bool BaselineLoad ( const char * filename, BaselineMap & entries )
+{
+  FILE * f = fopen(filename,"r");
+
+  if(f == NULL) return false;
+
+  char hash[128];
+  char test[64];
+  int param;
+
+  for(;;)
+  {
+    int c;
+
+    while(((c = fgetc(f)) != EOF) && isspace(c)) { }
+
+    if(c == EOF) break;
+
+    if(c == '#')
+    {
+      while(((c = fgetc(f)) != '\n') && (c != EOF)) { }
+      continue;
+    }
+
+    ungetc(c,f);
+
+    if(fscanf(f,"%127s %63s %d",hash,test,&param) != 3) break;
+
+    Histogram & h = entries[BaselineKey(hash,test,param)];
+
+    h.clear();
+
+    unsigned long long lo = 0, hi = 0;
+
+    bool range = (fscanf(f," min=%llu max=%llu",&lo,&hi) == 2);
+
+    unsigned long long value, count;
+
+    while(fscanf(f,"%llu:%llu",&value,&count) == 2)
+    {
+      const int i = Histogram::index(value);
+
+      if(range && (i == Histogram::index(lo)) && count)
+      {
+        h.record(lo);
+        count--;
+      }
+
+      if(range && (hi != lo) && (i == Histogram::index(hi)) && count)
+      {
+        h.record(hi);
+        count--;
+      }
+
+      h.record(value,count);
+    }
+  }
+
+  fclose(f);
+
+  return true;
+}
+
+bool BaselineSave ( const char * filename )
+{
+  BaselineMap entries;
+
+  BaselineLoad(filename,entries);
+
+  for(BaselineMap::iterator it = g_recorded.begin(); it != g_recorded.end(); ++it)
+  {
+    entries[it->first] = it->second;
+  }
+
+  FILE * f = fopen(filename,"w");
+
+  if(f == NULL)
+  {
+    printf("Can't write speed baseline '%s'\n",filename);
+    return false;
+  }
+
+  fprintf(f,"# SMHasher speed baseline - hash test param, min= and max= cycles, then midpoint:count cycle buckets\n");
+
+  for(BaselineMap::iterator it = entries.begin(); it != entries.end(); ++it)
+  {
+    const Histogram & h = it->second;
+
+    fprintf(f,"%s min=%llu max=%llu",it->first.c_str(),(unsigned long long)h.min(),(unsigned long long)h.max());
+
+    for(int i = 0; i < Histogram::BUCKETS; i++)
+    {
+      uint64_t mid = (Histogram::lowest(i) + Histogram::highest(i)) / 2;
+
+      if(h.bucket(i)) fprintf(f," %llu:%llu",(unsigned long long)mid,(unsigned long long)h.bucket(i));
+    }
+
+    fprintf(f,"\n");
+  }
+
+  fclose(f);
+
+  printf("Saved %d speed distributions to '%s'\n",(int)g_recorded.size(),filename);
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// One-sided Mann-Whitney U test on two bucketed distributions. Samples in
+// the same bucket are ties and get the bucket's midrank. Returns the p-value
+// for 'b' being stochastically larger (slower) than 'a' from the normal
+// approximation with tie correction, which is accurate at the sample sizes
+// the speed tests produce. 'effect' receives the probability of superiority
+// U / (n1 n2) - the chance that a random sample from 'b' is slower than a
+// random sample from 'a', with 0.5 meaning no difference.
+
+static double MannWhitney ( const Histogram & a, const Histogram & b, double & effect )
+{
+  double n1 = double(a.count());
+  double n2 = double(b.count());
+  double n = n1 + n2;
+
+  effect = 0.5;
+
+  if((n1 == 0) || (n2 == 0)) return 1.0;
+
+  double rank = 0;     // ranks used so far
+  double rankb = 0;    // sum of b's ranks
+  double ties = 0;     // sum of t^3 - t over tie groups
+
+  for(int i = 0; i < Histogram::BUCKETS; i++)
+  {
+    double ca = double(a.bucket(i));
+    double cb = double(b.bucket(i));
+    double t = ca + cb;
+
+    if(t == 0) continue;
+
+    double midrank = rank + (t + 1) / 2;
+
+    rankb += cb * midrank;
+    ties += t * t * t - t;
+    rank += t;
+  }
+
+  double u = rankb - n2 * (n2 + 1) / 2;
+
+  effect = u / (n1 * n2);
+
+  double var = (n1 * n2 / 12.0) * ((n + 1) - ties / (n * (n - 1)));
+
+  if(var <= 0) return 1.0;
+
+  // Continuity-corrected z, upper tail
+
+  double z = (u - n1 * n2 / 2 - 0.5) / sqrt(var);
+
+  return 0.5 * erfc(z / sqrt(2.0));
+}
+
+int BaselineCompare ( const char * filename )
+{
+  BaselineMap baseline;
+
+  if(!BaselineLoad(filename,baseline))
+  {
+    printf("Can't read speed baseline '%s'\n",filename);
+    return -1;
+  }
+
+  int comparisons = 0;
+
+  for(BaselineMap::iterator it = g_recorded.begin(); it != g_recorded.end(); ++it)
+  {
+    if(baseline.count(it->first)) comparisons++;
+  }
+
+  double alpha = comparisons ? g_baselineAlpha / comparisons : g_baselineAlpha;
+
+  printf("Speed regression check against '%s' - %d distributions, alpha %g (%g per test)\n",
+         filename,comparisons,g_baselineAlpha,alpha);
+  printf("Hash / test / param            | base median | median | change |  P(slower) |    p-value | verdict\n");
+
+  int slowdowns = 0;
+
+  for(BaselineMap::iterator it = g_recorded.begin(); it != g_recorded.end(); ++it)
+  {
+    BaselineMap::iterator b = baseline.find(it->first);
+
+    if(b == baseline.end())
+    {
+      printf("%-30s | no baseline\n",it->first.c_str());
+      continue;
+    }
+
+    const Histogram & before = b->second;
+    const Histogram & after = it->second;
+
+    double effect;
+    double p = MannWhitney(before,after,effect);
+
+    double m0 = before.percentile(50);
+    double m1 = after.percentile(50);
+    double change = (m0 > 0) ? (m1 - m0) / m0 : 0;
+
+    const char * verdict = "ok";
+
+    if((p < alpha) && (change >= g_baselineMinChange))
+    {
+      verdict = "SLOWER";
+      slowdowns++;
+    }
+    else if((p > 1.0 - alpha) && (change <= -g_baselineMinChange))
+    {
+      verdict = "faster";
+    }
+
+    printf("%-30s | %11.1f | %6.1f | %+5.1f%% | %10.3f | %10.3g | %s\n",
+           it->first.c_str(),m0,m1,change * 100.0,effect,p,verdict);
+  }
+
+  if(slowdowns) printf("%d significant slowdown(s)\n",slowdowns);
+
+  return slowdowns;
+}
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// Speed regression baselines. The bulk and small-key speed tests record their
+// full timing distributions here, per hash and per alignment/key length. A
+// run can save them to a baseline file, and a later run can compare its own
+// distributions against that file with a one-sided Mann-Whitney U test, so
+// "did this get slower" gets a yes/no answer backed by a significance level
+// and an effect size instead of eyeballing the printed medians.
+
+#pragma once
+
+#include "Histogram.h"
+
+// Distributions recorded by the speed tests are filed under this hash name
+
+void BaselineSetHash ( const char * name );
+
+// 'test' is e.g. "bulk" or "tiny", 'param' the alignment or key length
+
+void BaselineRecord ( const char * test, int param, const Histogram & samples );
+
+// Writes every recorded distribution to 'filename'. Entries already in the
+// file for other hashes or key lengths are kept, matching ones replaced.
+
+bool BaselineSave ( const char * filename );
+
+// Compares every recorded distribution against the matching entry in
+// 'filename' and prints a report. Returns the number of significant
+// slowdowns, or -1 if the file couldn't be read.
+
+// A slowdown counts as significant when the Mann-Whitney p-value is below
+// g_baselineAlpha (Bonferroni-corrected for the number of comparisons) and
+// the median got at least g_baselineMinChange slower, so that trivially
+// small shifts in huge samples don't trip it.
+
+extern double g_baselineAlpha;
+extern double g_baselineMinChange;
+
+int BaselineCompare ( const char * filename );
+
+//-----------------------------------------------------------------------------
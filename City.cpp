@@ -351,10 +351,17 @@ uint128 CityHash128(const char *s, size_t len) {
   }
 }
 
-#ifdef __SSE4_2__
+#ifdef CITY_HASH_CRC
 #include <nmmintrin.h>
 
+#if defined(__SSE4_2__)
+#define CITY_CRC_TARGET
+#else
+#define CITY_CRC_TARGET __attribute__((target("sse4.2")))
+#endif
+
 // Requires len >= 240.
+CITY_CRC_TARGET
 static void CityHashCrc256Long(const char *s, size_t len,
                                uint32 seed, uint64 *result) {
   uint64 a = Fetch64(s + 56) + k0;
@@ -88,8 +88,11 @@ inline uint64 Hash128to64(const uint128& x) {
 }
 
 // Conditionally include declarations for versions of City that require SSE4.2
-// instructions to be available.
-#ifdef __SSE4_2__
+// instructions to be available. With GCC on x86-64 they're built with a
+// target attribute instead of -msse4.2, so callers have to check the CPU
+// supports SSE4.2 before calling them.
+#if defined(__SSE4_2__) || (defined(__GNUC__) && defined(__x86_64__))
+#define CITY_HASH_CRC
 
 // Hash function for a byte array.
 uint128 CityHashCrc128(const char *s, size_t len);
@@ -101,6 +104,6 @@ uint128 CityHashCrc128WithSeed(const char *s, size_t len, uint128 seed);
 // Hash function for a byte array.  Sets result[0] ... result[3].
 void CityHashCrc256(const char *s, size_t len, uint64 *result);
 
-#endif  // __SSE4_2__
+#endif  // CITY_HASH_CRC
 
 #endif  // CITY_HASH_H_
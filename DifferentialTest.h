@@ -147,6 +147,7 @@ bool DiffTest ( pfHash hash, int diffbits, int reps, bool dumpCollisions )
   hashtype h1,h2;
 
   printf("Testing %0.f up-to-%d-bit differentials in %d-bit keys -> %d bit hashes.\n",diffcount,diffbits,keybits,hashbits);
+  ResultsSetTest("Differential","up-to-%d-bit differentials in %d-bit keys, %d reps",diffbits,keybits,reps);
   printf("%d reps, %0.f total tests, expecting %2.2f random collisions",reps,testcount,expected);
 
   for(int i = 0; i < reps; i++)
@@ -166,6 +167,12 @@ bool DiffTest ( pfHash hash, int diffbits, int reps, bool dumpCollisions )
 
   result &= ProcessDifferentials(diffs,reps,dumpCollisions);
 
+  ResultBegin();
+  ResultDouble("collisions_expected",expected);
+  ResultInt("collisions_actual",(int64_t)diffs.size());
+  ResultBool("pass",result);
+  ResultEnd();
+
   return result;
 }
 
@@ -259,6 +266,7 @@ bool DiffDistTest2 ( pfHash hash  )
   for(int keybit = 0; keybit < keybits; keybit++)
   {
     printf("Testing bit %d\n",keybit);
+    ResultsSetTest("DiffDist","%d-bit keys, bit %d",keybits,keybit);
 
     for(int i = 0; i < keycount; i++)
     {
@@ -0,0 +1,112 @@
+#include "Dispatch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+
+static uint32_t ProbeCPUFeatures ( void )
+{
+  uint32_t regs[4];
+  uint32_t features = 0;
+
+  cpuid(0,0,regs);
+
+  const uint32_t maxleaf = regs[0];
+
+  if(maxleaf < 1) return 0;
+
+  cpuid(1,0,regs);
+
+  const uint32_t ecx1 = regs[2];
+
+  if(ecx1 & (1 << 19)) features |= CPU_SSE41;
+  if(ecx1 & (1 << 20)) features |= CPU_SSE42;
+  if(ecx1 & (1 <<  1)) features |= CPU_PCLMUL;
+  if(ecx1 & (1 << 25)) features |= CPU_AES;
+
+  // AVX state has to be enabled by the OS - XCR0 bits 1-2 for the YMM
+  // registers, plus 5-7 for the opmask and ZMM registers.
+
+  uint64_t xcr0 = 0;
+
+  if(ecx1 & (1 << 27)) xcr0 = xgetbv(0);
+
+  const bool ymm = (ecx1 & (1 << 28)) && ((xcr0 & 0x06) == 0x06);
+  const bool zmm = ymm && ((xcr0 & 0xE6) == 0xE6);
+
+  if(maxleaf >= 7)
+  {
+    cpuid(7,0,regs);
+
+    const uint32_t ebx7 = regs[1];
+
+    if(ebx7 & (1 << 8)) features |= CPU_BMI2;
+
+    if(ymm && (ebx7 & (1 << 5))) features |= CPU_AVX2;
+
+    const uint32_t avx512 = (1 << 16) | (1u << 30) | (1u << 31);   // F, BW, VL
+
+    if(zmm && ((ebx7 & avx512) == avx512)) features |= CPU_AVX512;
+  }
+
+  return features;
+}
+
+uint32_t GetCPUFeatures ( void )
+{
+  static uint32_t features = 0;
+  static bool probed = false;
+
+  if(!probed)
+  {
+    features = ProbeCPUFeatures();
+    probed = true;
+  }
+
+  return features;
+}
+
+const char * CPUFeatureNames ( uint32_t features, char * buffer, int size )
+{
+  static const char * names[CPU_FEATURE_COUNT] =
+  {
+    "sse4.1", "sse4.2", "pclmul", "aes", "avx2", "bmi2", "avx512"
+  };
+
+  buffer[0] = 0;
+
+  int len = 0;
+
+  for(int i = 0; i < CPU_FEATURE_COUNT; i++)
+  {
+    if(features & (1 << i))
+    {
+      len += snprintf(buffer + len,size - len,"%s%s",len ? " " : "",names[i]);
+      if(len >= size) break;
+    }
+  }
+
+  if(buffer[0] == 0) snprintf(buffer,size,"none");
+
+  return buffer;
+}
+
+//-----------------------------------------------------------------------------
+
+bool VariantSupported ( const HashVariant & variant )
+{
+  return (variant.features & ~GetCPUFeatures()) == 0;
+}
+
+const HashVariant * SelectVariant ( const HashVariant * variants )
+{
+  for(const HashVariant * v = variants; v->hash; v++)
+  {
+    if(VariantSupported(*v)) return v;
+  }
+
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
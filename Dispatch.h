@@ -0,0 +1,50 @@
+//-----------------------------------------------------------------------------
+// Runtime CPU-feature dispatch. Hash implementations that need particular
+// instruction set extensions are compiled with per-function target
+// attributes instead of global -m flags, so one binary carries all of them.
+// The CPU is probed once, and each registry entry with a variant list is
+// bound to the first variant - fastest first - whose features are present.
+
+#pragma once
+
+#include "Types.h"
+
+enum CPUFeature
+{
+  CPU_SSE41  = 1 << 0,
+  CPU_SSE42  = 1 << 1,
+  CPU_PCLMUL = 1 << 2,
+  CPU_AES    = 1 << 3,
+  CPU_AVX2   = 1 << 4,
+  CPU_BMI2   = 1 << 5,
+  CPU_AVX512 = 1 << 6,   // AVX-512 F, BW and VL
+
+  CPU_FEATURE_COUNT = 7
+};
+
+// Features that both the CPU and the OS support (AVX2 and AVX-512 need the
+// OS to save the wider registers). Probed on the first call, then cached.
+
+uint32_t GetCPUFeatures ( void );
+
+// Space-separated names of the features in 'features', "none" if empty
+
+const char * CPUFeatureNames ( uint32_t features, char * buffer, int size );
+
+// A variant list is terminated by an entry with a NULL hash. The last entry
+// usually requires no features, so there's always something to bind to.
+
+struct HashVariant
+{
+  pfHash hash;
+  uint32_t features;
+  const char * name;
+};
+
+// The first supported variant, or NULL if the CPU supports none of them
+
+const HashVariant * SelectVariant ( const HashVariant * variants );
+
+bool VariantSupported ( const HashVariant & variant );
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,117 @@
+#include "EnergyCounters.h"
+
+#include <stdio.h>
+#include <string.h>
+
+EnergyCounters::EnergyCounters ( void ) : m_failed(false), m_total(0)
+{
+}
+
+#if defined(__linux__)
+
+static bool ReadMicrojoules ( const char * filename, double & value )
+{
+  FILE * f = fopen(filename,"r");
+
+  if(f == NULL) return false;
+
+  unsigned long long v;
+
+  bool ok = (fscanf(f,"%llu",&v) == 1);
+
+  fclose(f);
+
+  value = double(v);
+
+  return ok;
+}
+
+bool EnergyCounters::open ( void )
+{
+  if(active()) return true;
+  if(m_failed) return false;
+
+  // Top-level domains are intel-rapl:0, intel-rapl:1... - their subzones
+  // (core, uncore, dram) are already included in the package total.
+
+  for(int i = 0; i < 64; i++)
+  {
+    char path[128];
+    char name[64] = "";
+
+    snprintf(path,sizeof(path),"/sys/class/powercap/intel-rapl:%d/name",i);
+
+    FILE * f = fopen(path,"r");
+
+    if(f == NULL) continue;
+
+    bool named = (fscanf(f,"%63s",name) == 1);
+
+    fclose(f);
+
+    if(!named || (strncmp(name,"package",7) != 0)) continue;
+
+    double energy, range;
+
+    snprintf(path,sizeof(path),"/sys/class/powercap/intel-rapl:%d/max_energy_range_uj",i);
+
+    if(!ReadMicrojoules(path,range)) continue;
+
+    snprintf(path,sizeof(path),"/sys/class/powercap/intel-rapl:%d/energy_uj",i);
+
+    if(!ReadMicrojoules(path,energy)) continue;
+
+    m_files.push_back(path);
+    m_range.push_back(range);
+    m_last.push_back(energy);
+  }
+
+  m_total = 0;
+
+  if(!active()) m_failed = true;
+
+  return active();
+}
+
+bool EnergyCounters::read ( double & joules )
+{
+  joules = 0;
+
+  if(!active()) return false;
+
+  for(size_t i = 0; i < m_files.size(); i++)
+  {
+    double energy;
+
+    if(!ReadMicrojoules(m_files[i].c_str(),energy)) return false;
+
+    double delta = energy - m_last[i];
+
+    if(delta < 0) delta += m_range[i];
+
+    m_total += delta;
+    m_last[i] = energy;
+  }
+
+  joules = m_total * 1.0e-6;
+
+  return true;
+}
+
+#else
+
+bool EnergyCounters::open ( void )
+{
+  m_failed = true;
+  return false;
+}
+
+bool EnergyCounters::read ( double & joules )
+{
+  joules = 0;
+  return false;
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Types.h"
+
+#include <vector>
+#include <string>
+
+//-----------------------------------------------------------------------------
+// Package energy counters, read through Linux's RAPL powercap interface
+// (/sys/class/powercap/intel-rapl:N/energy_uj, also used for AMD parts).
+// Every package domain is summed, so the reading covers the cores, caches
+// and uncore of the whole machine - the power a rack actually pays for. The
+// psys/platform domain overlaps the packages and is left out.
+
+// The counters are cumulative microjoules that wrap at max_energy_range_uj;
+// read() accounts for one wrap per domain between calls, which at package
+// power levels leaves hours between reads.
+
+// Where there's no powercap directory, or energy_uj isn't readable (newer
+// kernels restrict it to root), nothing is available.
+
+class EnergyCounters
+{
+public:
+
+  EnergyCounters ( void );
+
+  bool open ( void );
+
+  bool active ( void ) const { return !m_files.empty(); }
+
+  int domains ( void ) const { return (int)m_files.size(); }
+
+  // Joules consumed by all package domains since open()
+
+  bool read ( double & joules );
+
+private:
+
+  bool m_failed;
+
+  std::vector<std::string> m_files;
+  std::vector<double> m_range;
+  std::vector<double> m_last;
+
+  double m_total;
+};
+
+//-----------------------------------------------------------------------------
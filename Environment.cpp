@@ -0,0 +1,362 @@
+#include "Environment.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Environment g_environment;
+
+//-----------------------------------------------------------------------------
+// CPU brand string from cpuid leaves 0x80000002-0x80000004
+
+static void GetCPUModel ( char * model, int size )
+{
+  uint32_t regs[4];
+  char brand[49];
+
+  model[0] = 0;
+
+  cpuid(0x80000000,0,regs);
+
+  if(regs[0] < 0x80000004) return;
+
+  for(uint32_t i = 0; i < 3; i++)
+  {
+    cpuid(0x80000002 + i,0,regs);
+    memcpy(brand + i * 16,regs,16);
+  }
+
+  brand[48] = 0;
+
+  // Intel pads the brand string with leading spaces
+
+  const char * p = brand;
+  while(*p == ' ') p++;
+
+  strncpy(model,p,size - 1);
+  model[size - 1] = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+
+// The Windows power settings don't map onto governors or turbo switches that
+// we can read without admin rights, so all we record is the OS version.
+
+void ReadEnvironment ( int cpu, bool pinned, Environment & env, int /*sampleMillis*/ )
+{
+  env.cpu = cpu;
+  env.pinned = pinned;
+
+  GetCPUModel(env.model,sizeof(env.model));
+
+  strcpy(env.kernel,"Windows");
+
+  env.governor[0] = 0;
+  env.turbo       = -1;
+  env.minfreq     = 0;
+  env.maxfreq     = 0;
+  env.curfreq     = 0;
+  env.isolated    = -1;
+  env.nohz        = -1;
+  env.siblings[0] = 0;
+  env.siblingBusy = -1;
+  env.loadavg     = -1;
+}
+
+#else
+
+#include <sys/utsname.h>
+
+// Read the first line of a /sys or /proc file, without the trailing newline
+
+static bool ReadLine ( const char * path, char * text, int size )
+{
+  FILE * f = fopen(path,"r");
+
+  if(f == NULL) return false;
+
+  bool ok = fgets(text,size,f) != NULL;
+
+  fclose(f);
+
+  if(!ok) return false;
+
+  text[strcspn(text,"\n")] = 0;
+
+  return true;
+}
+
+static int64_t ReadInt ( const char * path, int64_t def )
+{
+  char text[64];
+
+  if(!ReadLine(path,text,sizeof(text))) return def;
+
+  return strtoll(text,NULL,10);
+}
+
+// Is 'cpu' in a kernel cpulist such as "0-3,8,10-11"?
+
+static bool InCPUList ( const char * list, int cpu )
+{
+  const char * p = list;
+
+  while(*p)
+  {
+    char * end;
+
+    int lo = (int)strtol(p,&end,10);
+    if(end == p) break;
+
+    int hi = lo;
+
+    if(*end == '-')
+    {
+      p = end + 1;
+      hi = (int)strtol(p,&end,10);
+    }
+
+    if((cpu >= lo) && (cpu <= hi)) return true;
+
+    p = (*end == ',') ? end + 1 : end;
+  }
+
+  return false;
+}
+
+// Busy and total jiffies for every CPU in /proc/stat, indexed by CPU number
+
+static int ReadCPUTimes ( uint64_t * busy, uint64_t * total, int maxcpus )
+{
+  FILE * f = fopen("/proc/stat","r");
+
+  if(f == NULL) return 0;
+
+  char line[512];
+  int count = 0;
+
+  while(fgets(line,sizeof(line),f))
+  {
+    int cpu;
+    unsigned long long t[8] = { 0 };
+
+    if(sscanf(line,"cpu%d %llu %llu %llu %llu %llu %llu %llu %llu",
+              &cpu,&t[0],&t[1],&t[2],&t[3],&t[4],&t[5],&t[6],&t[7]) < 5) continue;
+
+    if((cpu < 0) || (cpu >= maxcpus)) continue;
+
+    // idle and iowait are the 4th and 5th columns
+
+    uint64_t sum = 0;
+    for(int i = 0; i < 8; i++) sum += t[i];
+
+    total[cpu] = sum;
+    busy[cpu] = sum - t[3] - t[4];
+
+    if(cpu + 1 > count) count = cpu + 1;
+  }
+
+  fclose(f);
+
+  return count;
+}
+
+void ReadEnvironment ( int cpu, bool pinned, Environment & env, int sampleMillis )
+{
+  char path[256];
+  char text[256];
+
+  env.cpu = cpu;
+  env.pinned = pinned;
+
+  GetCPUModel(env.model,sizeof(env.model));
+
+  //----------
+
+  utsname u;
+
+  if(uname(&u) == 0)
+  {
+    snprintf(env.kernel,sizeof(env.kernel),"%s %s %s",u.sysname,u.release,u.machine);
+  }
+  else
+  {
+    env.kernel[0] = 0;
+  }
+
+  //----------
+  // Frequency scaling
+
+  snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",cpu);
+
+  if(!ReadLine(path,env.governor,sizeof(env.governor))) env.governor[0] = 0;
+
+  snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d/cpufreq/scaling_min_freq",cpu);
+  env.minfreq = ReadInt(path,0);
+
+  snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d/cpufreq/scaling_max_freq",cpu);
+  env.maxfreq = ReadInt(path,0);
+
+  snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq",cpu);
+  env.curfreq = ReadInt(path,0);
+
+  // intel_pstate exposes turbo as a "no_turbo" switch, acpi-cpufreq and
+  // amd-pstate as "boost"
+
+  int64_t noturbo = ReadInt("/sys/devices/system/cpu/intel_pstate/no_turbo",-1);
+  int64_t boost   = ReadInt("/sys/devices/system/cpu/cpufreq/boost",-1);
+
+  if(noturbo >= 0)    env.turbo = noturbo ? 0 : 1;
+  else if(boost >= 0) env.turbo = boost ? 1 : 0;
+  else                env.turbo = -1;
+
+  //----------
+  // Isolation and SMT
+
+  if(ReadLine("/sys/devices/system/cpu/isolated",text,sizeof(text)))
+  {
+    env.isolated = InCPUList(text,cpu) ? 1 : 0;
+  }
+  else
+  {
+    env.isolated = -1;
+  }
+
+  if(ReadLine("/sys/devices/system/cpu/nohz_full",text,sizeof(text)))
+  {
+    env.nohz = InCPUList(text,cpu) ? 1 : 0;
+  }
+  else
+  {
+    env.nohz = -1;
+  }
+
+  snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",cpu);
+
+  if(!ReadLine(path,env.siblings,sizeof(env.siblings))) env.siblings[0] = 0;
+
+  // Sample every sibling's load from /proc/stat over the window. Our own
+  // CPU is excluded - we're asleep on it for the whole window anyway. A list
+  // with no ',' or '-' is just our own CPU, so there's nothing to sample.
+
+  env.siblingBusy = env.siblings[0] ? 0 : -1;
+
+  if(strpbrk(env.siblings,",-"))
+  {
+    const int maxcpus = 1024;
+
+    uint64_t * busy0  = new uint64_t[maxcpus];
+    uint64_t * total0 = new uint64_t[maxcpus];
+    uint64_t * busy1  = new uint64_t[maxcpus];
+    uint64_t * total1 = new uint64_t[maxcpus];
+
+    int count0 = ReadCPUTimes(busy0,total0,maxcpus);
+    SleepMillis(sampleMillis);
+    int count1 = ReadCPUTimes(busy1,total1,maxcpus);
+
+    int count = count0 < count1 ? count0 : count1;
+
+    for(int i = 0; i < count; i++)
+    {
+      if((i == cpu) || !InCPUList(env.siblings,i)) continue;
+
+      uint64_t dtotal = total1[i] - total0[i];
+      if(dtotal == 0) continue;
+
+      double load = double(busy1[i] - busy0[i]) / double(dtotal);
+
+      if(load > env.siblingBusy) env.siblingBusy = load;
+    }
+
+    delete [] busy0;
+    delete [] total0;
+    delete [] busy1;
+    delete [] total1;
+  }
+
+  //----------
+
+  env.loadavg = -1;
+
+  if(ReadLine("/proc/loadavg",text,sizeof(text))) env.loadavg = atof(text);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+static const char * Known ( const char * s )
+{
+  return s[0] ? s : "unknown";
+}
+
+static const char * Tristate ( int v, const char * yes, const char * no )
+{
+  return (v < 0) ? "unknown" : (v ? yes : no);
+}
+
+void PrintEnvironment ( const Environment & env )
+{
+  printf("CPU      - %s\n",Known(env.model));
+  printf("OS       - %s\n",Known(env.kernel));
+  if(env.pinned) printf("Pinned   - cpu %d",env.cpu);
+  else           printf("Pinned   - no (pinning to cpu %d failed)",env.cpu);
+
+  printf(", isolated %s, nohz_full %s, SMT siblings %s",
+         Tristate(env.isolated,"yes","no"),Tristate(env.nohz,"yes","no"),Known(env.siblings));
+
+  bool smt = strpbrk(env.siblings,",-") != NULL;
+
+  if(smt && (env.siblingBusy >= 0)) printf(" (busiest %.0f%% load)",env.siblingBusy * 100.0);
+
+  printf("\n");
+
+  printf("Clock    - governor %s, turbo %s",Known(env.governor),Tristate(env.turbo,"on","off"));
+
+  if(env.maxfreq) printf(", %.2f-%.2f GHz (now %.2f)",env.minfreq / 1e6,env.maxfreq / 1e6,env.curfreq / 1e6);
+
+  printf("\n");
+
+  if(env.loadavg >= 0) printf("Load     - %.2f (1 minute average)\n",env.loadavg);
+}
+
+int CheckEnvironment ( const Environment & env )
+{
+  int problems = 0;
+
+  if(!env.pinned)
+  {
+    printf("WARNING: not pinned to cpu %d - the scheduler can migrate us mid-measurement\n",env.cpu);
+    problems++;
+  }
+
+  if(env.isolated == 0)
+  {
+    printf("WARNING: cpu %d is not isolated (isolcpus) - other tasks can be scheduled on it\n",env.cpu);
+    problems++;
+  }
+
+  if(env.governor[0] && strcmp(env.governor,"performance"))
+  {
+    printf("WARNING: cpu %d uses the '%s' frequency governor, not 'performance'\n",env.cpu,env.governor);
+    problems++;
+  }
+
+  if(env.turbo == 1)
+  {
+    printf("WARNING: turbo boost is enabled - clock speed will vary with temperature and load\n");
+    problems++;
+  }
+
+  if(env.siblingBusy > 0.05)
+  {
+    printf("WARNING: an SMT sibling of cpu %d is %.0f%% busy\n",env.cpu,env.siblingBusy * 100.0);
+    problems++;
+  }
+
+  return problems;
+}
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,43 @@
+//-----------------------------------------------------------------------------
+// Benchmarking environment. Speed results are only comparable between runs
+// if the core they ran on wasn't being reclocked or shared, so before the
+// speed tests we record what the OS tells us about the benchmark CPU -
+// frequency governor, turbo, SMT siblings and their load, isolation - and
+// print it alongside the results.
+
+#pragma once
+
+#include "Platform.h"
+
+struct Environment
+{
+  int     cpu;            // logical CPU the benchmarks are pinned to
+  bool    pinned;         // false if pinning to 'cpu' failed
+  char    model[64];      // CPU brand string
+  char    kernel[208];    // OS name, release and machine
+  char    governor[32];   // cpufreq scaling governor, "" if unknown
+  int     turbo;          // 1 = turbo/boost enabled, 0 = disabled, -1 = unknown
+  int64_t minfreq;        // cpufreq limits and current frequency in kHz, 0 if unknown
+  int64_t maxfreq;
+  int64_t curfreq;
+  int     isolated;       // 1 = cpu is in the kernel's isolcpus set, -1 = unknown
+  int     nohz;           // 1 = cpu is in the kernel's nohz_full set, -1 = unknown
+  char    siblings[64];   // SMT siblings of 'cpu' (kernel cpulist format), "" if unknown
+  double  siblingBusy;    // busiest sibling's load over the sampling window (0-1), -1 if unknown
+  double  loadavg;        // 1-minute load average, -1 if unknown
+};
+
+extern Environment g_environment;
+
+// Fills 'env' for the given CPU, which 'pinned' says whether SetAffinity
+// managed to pin us to. Sampling sibling load takes 'sampleMillis'.
+
+void ReadEnvironment  ( int cpu, bool pinned, Environment & env, int sampleMillis = 200 );
+void PrintEnvironment ( const Environment & env );
+
+// Prints a warning for each condition that's likely to make speed results
+// noisy or non-comparable, and returns how many there were.
+
+int  CheckEnvironment ( const Environment & env );
+
+//-----------------------------------------------------------------------------
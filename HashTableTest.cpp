@@ -0,0 +1,423 @@
+#include "HashTableTest.h"
+
+#include "SpeedTest.h" // for CyclesToNanos
+#include "Random.h"
+#include "Results.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// 16-byte keys, the size of a typical composite key. An all-zero key marks an
+// empty slot, so generated keys always have the low bit set.
+
+struct TableKey
+{
+  uint64_t a;
+  uint64_t b;
+};
+
+inline bool operator == ( const TableKey & x, const TableKey & y )
+{
+  return (x.a == y.a) && (x.b == y.b);
+}
+
+inline bool IsEmpty ( const TableKey & k )
+{
+  return (k.a == 0) && (k.b == 0);
+}
+
+// Maps the hash onto [0,size) with a multiply instead of a modulo, so table
+// sizes don't have to be powers of two and load factors come out exact.
+
+inline size_t HashSlot ( pfHash hash, uint32_t seed, const TableKey & k, size_t size )
+{
+  uint32_t out[16];
+
+  hash(&k,sizeof(k),seed,out);
+
+  return size_t((uint64_t(out[0]) * size) >> 32);
+}
+
+//-----------------------------------------------------------------------------
+// All three tables return the number of slots or nodes they looked at.
+
+class LinearTable
+{
+public:
+
+  LinearTable ( pfHash hash, uint32_t seed, size_t size )
+  : m_hash(hash), m_seed(seed), m_slots(size)
+  {
+  }
+
+  static const char * name ( void ) { return "linear"; }
+
+  void clear ( void )
+  {
+    std::fill(m_slots.begin(),m_slots.end(),TableKey());
+  }
+
+  int insert ( const TableKey & k )
+  {
+    size_t i = HashSlot(m_hash,m_seed,k,m_slots.size());
+
+    for(int probes = 1; ; probes++)
+    {
+      if(IsEmpty(m_slots[i]) || (m_slots[i] == k))
+      {
+        m_slots[i] = k;
+        return probes;
+      }
+
+      if(++i == m_slots.size()) i = 0;
+    }
+  }
+
+  int find ( const TableKey & k ) const
+  {
+    size_t i = HashSlot(m_hash,m_seed,k,m_slots.size());
+
+    for(int probes = 1; ; probes++)
+    {
+      if(m_slots[i] == k) return probes;
+      if(IsEmpty(m_slots[i])) return probes;
+
+      if(++i == m_slots.size()) i = 0;
+    }
+  }
+
+private:
+
+  pfHash m_hash;
+  uint32_t m_seed;
+  std::vector<TableKey> m_slots;
+};
+
+//----------
+// Robin Hood - linear probing where an insert takes the slot of any key
+// that's closer to its home slot than the new key is to its own. That keeps
+// probe lengths even, and lets a failed lookup stop as soon as it passes a
+// key closer to home than it is.
+
+class RobinHoodTable
+{
+public:
+
+  RobinHoodTable ( pfHash hash, uint32_t seed, size_t size )
+  : m_hash(hash), m_seed(seed), m_slots(size), m_dist(size)
+  {
+  }
+
+  static const char * name ( void ) { return "robinhood"; }
+
+  void clear ( void )
+  {
+    std::fill(m_slots.begin(),m_slots.end(),TableKey());
+    std::fill(m_dist.begin(),m_dist.end(),0);
+  }
+
+  // m_dist holds the distance from the key's home slot plus one, 0 = empty
+
+  int insert ( TableKey k )
+  {
+    size_t i = HashSlot(m_hash,m_seed,k,m_slots.size());
+    int dist = 1;
+
+    for(int probes = 1; ; probes++)
+    {
+      if(m_dist[i] == 0)
+      {
+        m_slots[i] = k;
+        m_dist[i] = dist;
+        return probes;
+      }
+
+      if((m_dist[i] == dist) && (m_slots[i] == k)) return probes;
+
+      if(m_dist[i] < dist)
+      {
+        std::swap(m_slots[i],k);
+        std::swap(m_dist[i],dist);
+      }
+
+      dist++;
+
+      if(++i == m_slots.size()) i = 0;
+    }
+  }
+
+  int find ( const TableKey & k ) const
+  {
+    size_t i = HashSlot(m_hash,m_seed,k,m_slots.size());
+
+    for(int dist = 1; ; dist++)
+    {
+      if(m_dist[i] < dist) return dist;
+      if(m_slots[i] == k) return dist;
+
+      if(++i == m_slots.size()) i = 0;
+    }
+  }
+
+private:
+
+  pfHash m_hash;
+  uint32_t m_seed;
+  std::vector<TableKey> m_slots;
+  std::vector<int> m_dist;
+};
+
+//----------
+// Separate chaining - a bucket array of list heads into a node pool. New
+// keys go on the front of their chain.
+
+class ChainedTable
+{
+public:
+
+  ChainedTable ( pfHash hash, uint32_t seed, size_t size )
+  : m_hash(hash), m_seed(seed), m_heads(size)
+  {
+  }
+
+  static const char * name ( void ) { return "chained"; }
+
+  void clear ( void )
+  {
+    std::fill(m_heads.begin(),m_heads.end(),0);
+    m_nodes.clear();
+  }
+
+  // Node indices are stored plus one, 0 = end of chain
+
+  int insert ( const TableKey & k )
+  {
+    size_t b = HashSlot(m_hash,m_seed,k,m_heads.size());
+
+    int probes = 0;
+
+    for(uint32_t n = m_heads[b]; n; n = m_nodes[n-1].next)
+    {
+      probes++;
+      if(m_nodes[n-1].key == k) return probes;
+    }
+
+    Node node;
+    node.key = k;
+    node.next = m_heads[b];
+
+    m_nodes.push_back(node);
+    m_heads[b] = (uint32_t)m_nodes.size();
+
+    return probes + 1;
+  }
+
+  int find ( const TableKey & k ) const
+  {
+    size_t b = HashSlot(m_hash,m_seed,k,m_heads.size());
+
+    int probes = 1;
+
+    for(uint32_t n = m_heads[b]; n; n = m_nodes[n-1].next)
+    {
+      if(m_nodes[n-1].key == k) return probes;
+      probes++;
+    }
+
+    return probes;
+  }
+
+  void reserve ( size_t count ) { m_nodes.reserve(count); }
+
+private:
+
+  struct Node
+  {
+    TableKey key;
+    uint32_t next;
+  };
+
+  pfHash m_hash;
+  uint32_t m_seed;
+  std::vector<uint32_t> m_heads;
+  std::vector<Node> m_nodes;
+};
+
+//-----------------------------------------------------------------------------
+
+struct TableStats
+{
+  double nanos;     // median ns/op over the repetitions
+  double probes;    // average probes/op
+  int maxprobes;
+};
+
+double Median ( std::vector<double> & v )
+{
+  std::sort(v.begin(),v.end());
+  return v[v.size() / 2];
+}
+
+void ReserveNodes ( LinearTable &, size_t ) {}
+void ReserveNodes ( RobinHoodTable &, size_t ) {}
+void ReserveNodes ( ChainedTable & t, size_t count ) { t.reserve(count); }
+
+// Insert all of 'keys' into an empty table, then look up a sample of them
+// and the same number of keys that aren't in the table. Small tables are
+// rebuilt and re-timed enough times to get a stable median.
+
+template < class table >
+void TimeTable ( pfHash hash, uint32_t seed, const std::vector<TableKey> & keys,
+                 const std::vector<TableKey> & hits, const std::vector<TableKey> & misses,
+                 double load, TableStats stats[3] )
+{
+  const size_t count = keys.size();
+
+  const int reps = (int)std::max<size_t>(1,std::min<size_t>(99,(1 << 20) / count));
+
+  table t(hash,seed,(size_t)(count / load));
+
+  ReserveNodes(t,count);
+
+  std::vector<double> times[3];
+
+  for(int i = 0; i < 3; i++)
+  {
+    stats[i].probes = 0;
+    stats[i].maxprobes = 0;
+  }
+
+  for(int rep = 0; rep < reps; rep++)
+  {
+    t.clear();
+
+    for(int op = 0; op < 3; op++)
+    {
+      const std::vector<TableKey> & v = (op == 0) ? keys : (op == 1) ? hits : misses;
+
+      double sum = 0;
+      int maxp = 0;
+
+      uint64_t begin = timer_start();
+
+      for(size_t i = 0; i < v.size(); i++)
+      {
+        int p = (op == 0) ? t.insert(v[i]) : t.find(v[i]);
+
+        sum += p;
+        if(p > maxp) maxp = p;
+      }
+
+      uint64_t end = timer_end();
+
+      times[op].push_back(CyclesToNanos(double(end - begin)) / v.size());
+
+      stats[op].probes = sum / v.size();
+      stats[op].maxprobes = std::max(stats[op].maxprobes,maxp);
+    }
+  }
+
+  for(int op = 0; op < 3; op++) stats[op].nanos = Median(times[op]);
+}
+
+template < class table >
+void TableRow ( pfHash hash, uint32_t seed, const std::vector<TableKey> & keys,
+                const std::vector<TableKey> & hits, const std::vector<TableKey> & misses, double load )
+{
+  TableStats stats[3];
+
+  ResultsSetTest("HashTable","%s, %d keys, load %.2f",table::name(),(int)keys.size(),load);
+
+  TimeTable<table>(hash,seed,keys,hits,misses,load,stats);
+
+  printf("%-9s | %9d | %4.2f | %12.2f %6.2f %5d | %9.2f %6.2f %5d | %9.2f %6.2f %5d\n",
+         table::name(),(int)keys.size(),load,
+         stats[0].nanos,stats[0].probes,stats[0].maxprobes,
+         stats[1].nanos,stats[1].probes,stats[1].maxprobes,
+         stats[2].nanos,stats[2].probes,stats[2].maxprobes);
+
+  const char * ops[3] = { "insert", "hit", "miss" };
+
+  ResultBegin();
+
+  for(int op = 0; op < 3; op++)
+  {
+    char key[32];
+
+    snprintf(key,sizeof(key),"%s_ns",ops[op]);
+    ResultDouble(key,stats[op].nanos);
+
+    snprintf(key,sizeof(key),"%s_probes",ops[op]);
+    ResultDouble(key,stats[op].probes);
+
+    snprintf(key,sizeof(key),"%s_max_probes",ops[op]);
+    ResultInt(key,stats[op].maxprobes);
+  }
+
+  ResultEnd();
+}
+
+void RandomKeys ( Rand & r, size_t count, std::vector<TableKey> & keys )
+{
+  keys.resize(count);
+
+  for(size_t i = 0; i < count; i++)
+  {
+    keys[i].a = r.rand_u64() | 1;
+    keys[i].b = r.rand_u64();
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void HashTableTest ( pfHash hash, uint32_t seed )
+{
+  // The largest table holds four times the last-level cache's worth of keys,
+  // within limits that keep the run's memory use sane.
+
+  int64_t llc = GetCacheSize(3);
+  if(llc <= 0) llc = GetCacheSize(2);
+  if(llc <= 0) llc = 8 * 1024 * 1024;
+
+  size_t large = (size_t)std::min<int64_t>(16 << 20,std::max<int64_t>(4 << 20,(llc * 4) / (int64_t)sizeof(TableKey)));
+
+  const size_t counts[4] = { 1 << 10, 1 << 15, 1 << 20, large };
+  const double loads[4] = { 0.5, 0.75, 0.9, 0.95 };
+
+  // Lookups use a sample of at most a million keys, spread evenly over the
+  // insertion order - keys inserted early have shorter probe sequences.
+
+  const size_t maxlookups = 1 << 20;
+
+  printf("Hash table test - %d-byte keys, %d to %d keys, last-level cache %d KiB\n",
+         (int)sizeof(TableKey),(int)counts[0],(int)counts[3],(int)(llc / 1024));
+  printf("Table     |      Keys | Load | insert ns/op probes   max | hit ns/op probes   max | miss ns/op probes  max\n");
+
+  Rand r(seed);
+
+  std::vector<TableKey> keys;
+  std::vector<TableKey> hits;
+  std::vector<TableKey> misses;
+
+  for(int c = 0; c < 4; c++)
+  {
+    const size_t count = counts[c];
+    const size_t lookups = std::min(count,maxlookups);
+
+    RandomKeys(r,count,keys);
+    RandomKeys(r,lookups,misses);
+
+    hits.resize(lookups);
+    for(size_t i = 0; i < lookups; i++) hits[i] = keys[(i * count) / lookups];
+
+    for(int l = 0; l < 4; l++)
+    {
+      TableRow<LinearTable>   (hash,seed,keys,hits,misses,loads[l]);
+      TableRow<RobinHoodTable>(hash,seed,keys,hits,misses,loads[l]);
+      TableRow<ChainedTable>  (hash,seed,keys,hits,misses,loads[l]);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
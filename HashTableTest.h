@@ -0,0 +1,15 @@
+//-----------------------------------------------------------------------------
+// Hash table tests build real tables keyed through the hash under test -
+// linear probing, Robin Hood and separate chaining - and time inserts,
+// successful lookups and failed lookups at a range of load factors and table
+// sizes, from L1-resident to several times the last-level cache. Probe
+// lengths are reported next to the timings, so a hash that's fast per call
+// but clusters keys shows up as such.
+
+#pragma once
+
+#include "Types.h"
+
+void HashTableTest ( pfHash hash, uint32_t seed );
+
+//-----------------------------------------------------------------------------
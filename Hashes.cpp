@@ -60,6 +60,43 @@ void DoNothingHash ( const void *, int, uint32_t, void * )
 {
 }
 
+//----------
+
+int GetHashTables ( pfHash hash, HashTable * tables, int maxtables )
+{
+  int count = 0;
+
+  if((hash == crc32) && (count < maxtables))
+  {
+    tables[count].ptr = crc32_table(tables[count].size);
+    count++;
+  }
+
+  // Slicing-by-8 only touches the first half of the slicing tables. crc32_clmul
+  // runs short keys and tails through slicing-by-16.
+
+  if(((hash == crc32_slice8) || (hash == crc32_slice16) || (hash == crc32_clmul)) && (count < maxtables))
+  {
+    tables[count].ptr = crc32_slice_table(tables[count].size);
+    if(hash == crc32_slice8) tables[count].size /= 2;
+    count++;
+  }
+
+  if((hash == crc32c_sw) && (count < maxtables))
+  {
+    tables[count].ptr = crc32c_table(tables[count].size);
+    count++;
+  }
+
+  if((hash == md5_32) && (count < maxtables))
+  {
+    tables[count].ptr = md5_table(tables[count].size);
+    count++;
+  }
+
+  return count;
+}
+
 //-----------------------------------------------------------------------------
 // One-byte-at-a-time hash based on Murmur's mix
 
@@ -14,6 +14,15 @@ void sumhash32             ( const void * key, int len, uint32_t seed, void * ou
 
 void DoNothingHash         ( const void * key, int len, uint32_t seed, void * out );
 void crc32                 ( const void * key, int len, uint32_t seed, void * out );
+void crc32_slice8          ( const void * key, int len, uint32_t seed, void * out );
+void crc32_slice16         ( const void * key, int len, uint32_t seed, void * out );
+void crc32c_sw             ( const void * key, int len, uint32_t seed, void * out );
+
+// These need instruction set extensions - see the variant tables in main.cpp,
+// which only bind them on CPUs that have them
+
+void crc32_clmul           ( const void * key, int len, uint32_t seed, void * out );
+void crc32c_hw             ( const void * key, int len, uint32_t seed, void * out );
 
 void randhash_32           ( const void * key, int len, uint32_t seed, void * out );
 void randhash_64           ( const void * key, int len, uint32_t seed, void * out );
@@ -37,10 +46,37 @@ void Crap8_test            ( const void * key, int len, uint32_t seed, void * ou
 void CityHash128_test      ( const void * key, int len, uint32_t seed, void * out );
 void CityHash64_test       ( const void * key, int len, uint32_t seed, void * out );
 
+// Same condition as CITY_HASH_CRC in City.h
+
+#if defined(__SSE4_2__) || (defined(__GNUC__) && defined(__x86_64__))
+#define SMHASHER_CITY_CRC
+void CityHashCrc128_test         ( const void * key, int len, uint32_t seed, void * out );
+void CityHashCrc128WithSeed_test ( const void * key, int len, uint32_t seed, void * out );
+void CityHashCrc256_test         ( const void * key, int len, uint32_t seed, void * out );
+#endif
+
 void SpookyHash32_test     ( const void * key, int len, uint32_t seed, void * out );
 void SpookyHash64_test     ( const void * key, int len, uint32_t seed, void * out );
 void SpookyHash128_test    ( const void * key, int len, uint32_t seed, void * out );
 
+//----------
+// Lookup tables that a hash reads on every call, so the cold-cache speed
+// tests can flush them along with the key. Returns how many were written to
+// 'tables'.
+
+struct HashTable
+{
+  const void * ptr;
+  size_t size;
+};
+
+int GetHashTables ( pfHash hash, HashTable * tables, int maxtables );
+
+const void * crc32_table       ( size_t & size );
+const void * crc32_slice_table ( size_t & size );
+const void * crc32c_table      ( size_t & size );
+const void * md5_table         ( size_t & size );
+
 uint32_t MurmurOAAT ( const void * key, int len, uint32_t seed );
 
 //----------
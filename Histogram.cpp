@@ -0,0 +1,94 @@
+#include "Histogram.h"
+
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+
+void Histogram::clear ( void )
+{
+  memset(m_counts,0,sizeof(m_counts));
+
+  m_total = 0;
+  m_min = ~uint64_t(0);
+  m_max = 0;
+  m_sum = 0;
+}
+
+void Histogram::add ( const Histogram & h )
+{
+  for(int i = 0; i < BUCKETS; i++) m_counts[i] += h.m_counts[i];
+
+  m_total += h.m_total;
+  m_sum += h.m_sum;
+
+  if(h.m_total && (h.m_min < m_min)) m_min = h.m_min;
+  if(h.m_max > m_max) m_max = h.m_max;
+}
+
+//----------
+
+uint64_t Histogram::lowest ( int i )
+{
+  if(i < 2*SUBCOUNT) return (uint64_t)i;
+
+  int shift = (i - 2*SUBCOUNT) / SUBCOUNT + 1;
+  int sub = (i - 2*SUBCOUNT) % SUBCOUNT;
+
+  return uint64_t(SUBCOUNT + sub) << shift;
+}
+
+uint64_t Histogram::highest ( int i )
+{
+  if(i < 2*SUBCOUNT) return (uint64_t)i;
+
+  int shift = (i - 2*SUBCOUNT) / SUBCOUNT + 1;
+
+  return lowest(i) + (uint64_t(1) << shift) - 1;
+}
+
+double Histogram::value ( int i )
+{
+  return (double(lowest(i)) + double(highest(i))) / 2.0;
+}
+
+//----------
+
+double Histogram::rank ( uint64_t r ) const
+{
+  if(m_total == 0) return 0;
+
+  if(r < 1) r = 1;
+  if(r >= m_total) return double(m_max);
+
+  uint64_t seen = 0;
+
+  for(int i = 0; i < BUCKETS; i++)
+  {
+    seen += m_counts[i];
+
+    if(seen >= r)
+    {
+      double v = value(i);
+
+      if(v < double(m_min)) v = double(m_min);
+      if(v > double(m_max)) v = double(m_max);
+
+      return v;
+    }
+  }
+
+  return double(m_max);
+}
+
+double Histogram::percentile ( double p ) const
+{
+  double r = p / 100.0 * double(m_total);
+
+  uint64_t ir = (uint64_t)r;
+
+  if(double(ir) < r) ir++;
+
+  return rank(ir);
+}
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Platform.h"
+
+//-----------------------------------------------------------------------------
+// Fixed-size log-linear histogram for timing samples, in the spirit of
+// HdrHistogram. Values below 128 get their own bucket; above that each
+// power-of-two range is split into 64 equal sub-buckets, so any recorded
+// value is known to within 1/64th (about 1.6%). Values past 2^32 all land in
+// the top bucket, though the exact maximum is tracked separately.
+
+// Recording a sample is O(1) and the whole thing is ~14k no matter how many
+// samples go into it.
+
+class Histogram
+{
+public:
+
+  enum
+  {
+    SUBBITS = 6,
+    SUBCOUNT = 1 << SUBBITS,
+    MAXBITS = 32,
+    BUCKETS = 2*SUBCOUNT + (MAXBITS - SUBBITS - 1) * SUBCOUNT,
+  };
+
+  Histogram ( void )
+  {
+    clear();
+  }
+
+  void clear ( void );
+
+  static int index ( uint64_t v )
+  {
+    if(v < 2*SUBCOUNT) return (int)v;
+
+    int msb = 63 - clz64(v);
+
+    if(msb >= MAXBITS) return BUCKETS - 1;
+
+    int shift = msb - SUBBITS;
+
+    return 2*SUBCOUNT + (shift-1)*SUBCOUNT + (int)((v >> shift) - SUBCOUNT);
+  }
+
+  void record ( uint64_t v )
+  {
+    m_counts[index(v)]++;
+    m_total++;
+    m_sum += double(v);
+
+    if(v < m_min) m_min = v;
+    if(v > m_max) m_max = v;
+  }
+
+  // 'n' samples of the same value
+
+  void record ( uint64_t v, uint64_t n )
+  {
+    if(n == 0) return;
+
+    m_counts[index(v)] += n;
+    m_total += n;
+    m_sum += double(v) * double(n);
+
+    if(v < m_min) m_min = v;
+    if(v > m_max) m_max = v;
+  }
+
+  void add ( const Histogram & h );
+
+  uint64_t count ( void ) const { return m_total; }
+  uint64_t min   ( void ) const { return m_total ? m_min : 0; }
+  uint64_t max   ( void ) const { return m_max; }
+  double   mean  ( void ) const { return m_total ? m_sum / double(m_total) : 0; }
+
+  uint64_t bucket ( int i ) const { return m_counts[i]; }
+
+  // Smallest and largest value that map to bucket 'i', and a representative
+  // value (the midpoint) for the bucket.
+
+  static uint64_t lowest  ( int i );
+  static uint64_t highest ( int i );
+  static double   value   ( int i );
+
+  // Value at the given percentile (0-100), e.g. percentile(99.9). Accurate
+  // to within the bucket resolution, and never outside [min,max].
+
+  double percentile ( double p ) const;
+
+  // Value at the given 1-based rank in sorted order
+
+  double rank ( uint64_t r ) const;
+
+private:
+
+  static int clz64 ( uint64_t v )
+  {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanReverse64(&i,v);
+    return 63 - (int)i;
+#else
+    return __builtin_clzll(v);
+#endif
+  }
+
+  uint64_t m_counts[BUCKETS];
+  uint64_t m_total;
+  uint64_t m_min;
+  uint64_t m_max;
+  double   m_sum;
+};
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,78 @@
+#include "SpeedTest.h"
+#include "Hashes.h"
+
+//-----------------------------------------------------------------------------
+// Instantiations of InlinedSpeedTest for the built-in hashes, looked up by
+// function pointer so main() can run them for whatever hash is under test.
+
+typedef void (*pfInlinedTest) ( pfHash hash, int hashsize, uint32_t seed );
+
+struct InlinedTestInfo
+{
+  pfHash hash;
+  pfInlinedTest test;
+};
+
+#define INLINED_TEST(fn) { fn, InlinedSpeedTest< DirectHash<fn> > }
+
+InlinedTestInfo g_inlinedTests[] =
+{
+  INLINED_TEST(DoNothingHash),
+
+  INLINED_TEST(crc32),
+  INLINED_TEST(crc32_slice8),
+  INLINED_TEST(crc32_slice16),
+  INLINED_TEST(crc32_clmul),
+  INLINED_TEST(crc32c_hw),
+  INLINED_TEST(crc32c_sw),
+
+  INLINED_TEST(md5_32),
+  INLINED_TEST(sha1_32a),
+
+  INLINED_TEST(FNV),
+  INLINED_TEST(Bernstein),
+  INLINED_TEST(lookup3_test),
+  INLINED_TEST(SuperFastHash),
+  INLINED_TEST(MurmurOAAT_test),
+  INLINED_TEST(Crap8_test),
+
+  INLINED_TEST(CityHash64_test),
+  INLINED_TEST(CityHash128_test),
+
+#ifdef SMHASHER_CITY_CRC
+  INLINED_TEST(CityHashCrc128_test),
+  INLINED_TEST(CityHashCrc128WithSeed_test),
+  INLINED_TEST(CityHashCrc256_test),
+#endif
+
+  INLINED_TEST(SpookyHash64_test),
+  INLINED_TEST(SpookyHash128_test),
+
+  INLINED_TEST(MurmurHash2_test),
+  INLINED_TEST(MurmurHash2A_test),
+  INLINED_TEST(MurmurHash64A_test),
+  INLINED_TEST(MurmurHash64B_test),
+
+  INLINED_TEST(MurmurHash3_x86_32),
+  INLINED_TEST(MurmurHash3_x86_128),
+  INLINED_TEST(MurmurHash3_x64_128),
+};
+
+bool RunInlinedSpeedTest ( pfHash hash, int hashsize, uint32_t seed )
+{
+  for(size_t i = 0; i < sizeof(g_inlinedTests) / sizeof(InlinedTestInfo); i++)
+  {
+    if(g_inlinedTests[i].hash == hash)
+    {
+#if !defined(SMHASHER_LTO)
+      printf("WARNING: Built without link-time optimization, hash bodies will not be inlined\n");
+#endif
+      g_inlinedTests[i].test(hash,hashsize,seed);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//-----------------------------------------------------------------------------
@@ -47,6 +47,19 @@ bool VerificationTest ( pfHash hash, const int hashbits, uint32_t expected, bool
 
   //----------
 
+  // SelfTest runs this quietly for every hash, so only the verbose run in
+  // the sanity tests is a result
+
+  if(verbose)
+  {
+    ResultsSetTest("Verification","");
+    ResultBegin();
+    ResultInt("verification",verification);
+    ResultInt("expected",expected);
+    ResultBool("pass",expected == verification);
+    ResultEnd();
+  }
+
   if(expected != verification)
   {
     if(verbose) printf("Verification value 0x%08X : Failed! (Expected 0x%08x)\n",verification,expected);
@@ -74,6 +87,7 @@ bool VerificationTest ( pfHash hash, const int hashbits, uint32_t expected, bool
 bool SanityTest ( pfHash hash, const int hashbits )
 {
   printf("Running sanity check 1");
+  ResultsSetTest("Sanity","");
   
   Rand r(883741);
 
@@ -149,6 +163,10 @@ bool SanityTest ( pfHash hash, const int hashbits )
   delete [] hash1;
   delete [] hash2;
 
+  ResultBegin();
+  ResultBool("pass",result);
+  ResultEnd();
+
   return result;
 }
 
@@ -159,6 +177,7 @@ bool SanityTest ( pfHash hash, const int hashbits )
 void AppendedZeroesTest ( pfHash hash, const int hashbits )
 {
   printf("Running sanity check 2");
+  ResultsSetTest("AppendedZeroes","");
   
   Rand r(173994);
 
@@ -187,6 +206,11 @@ void AppendedZeroesTest ( pfHash hash, const int hashbits )
       if(memcmp(h1,h2,hashbytes) == 0)
       {
         printf("\n*********FAIL*********\n");
+
+        ResultBegin();
+        ResultBool("pass",false);
+        ResultEnd();
+
         return;
       }
 
@@ -195,6 +219,10 @@ void AppendedZeroesTest ( pfHash hash, const int hashbits )
   }
 
   printf("PASS\n");
+
+  ResultBegin();
+  ResultBool("pass",true);
+  ResultEnd();
 }
 
 //-----------------------------------------------------------------------------
@@ -214,6 +242,7 @@ void TwoBytesKeygen ( int maxlen, KeyCallback & c )
   for(int i = 2; i <= maxlen; i++) keycount += i*255;
 
   printf("Keyset 'TwoBytes' - up-to-%d-byte keys, %d total keys\n",maxlen, keycount);
+  ResultsSetTest("TwoBytes","up-to-%d-byte keys",maxlen);
 
   c.reserve(keycount);
 
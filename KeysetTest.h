@@ -53,6 +53,7 @@ template< typename hashtype >
 bool CombinationKeyTest ( hashfunc<hashtype> hash, int maxlen, uint32_t * blocks, int blockcount, bool testColl, bool testDist, bool drawDiagram )
 {
   printf("Keyset 'Combination' - up to %d blocks from a set of %d - ",maxlen,blockcount);
+  ResultsSetTest("Combination","up to %d blocks from a set of %d",maxlen,blockcount);
 
   //----------
 
@@ -109,6 +110,7 @@ template< typename hashtype >
 bool PermutationKeyTest ( hashfunc<hashtype> hash, uint32_t * blocks, int blockcount, bool testColl, bool testDist, bool drawDiagram )
 {
   printf("Keyset 'Permutation' - %d blocks - ",blockcount);
+  ResultsSetTest("Permutation","%d blocks",blockcount);
 
   //----------
 
@@ -165,6 +167,7 @@ template < int keybits, typename hashtype >
 bool SparseKeyTest ( hashfunc<hashtype> hash, const int setbits, bool inclusive, bool testColl, bool testDist, bool drawDiagram  )
 {
   printf("Keyset 'Sparse' - %d-bit keys with %s %d bits set - ",keybits, inclusive ? "up to" : "exactly", setbits);
+  ResultsSetTest("Sparse","%d-bit keys with %s %d bits set",keybits, inclusive ? "up to" : "exactly", setbits);
 
   typedef Blob<keybits> keytype;
 
@@ -231,6 +234,7 @@ bool WindowedKeyTest ( hashfunc<hashtype> hash, const int windowbits, bool testC
     }
 
     printf("Window at %3d - ",j);
+    ResultsSetTest("Windowed","%d-bit key, %d-bit window at %d",keybits,windowbits,j);
 
     result &= TestHashList(hashes,testCollision,testDistribution,drawDiagram);
 
@@ -250,6 +254,7 @@ template < typename hashtype >
 bool CyclicKeyTest ( pfHash hash, int cycleLen, int cycleReps, const int keycount, bool drawDiagram )
 {
   printf("Keyset 'Cyclic' - %d cycles of %d bytes - %d keys\n",cycleReps,cycleLen,keycount);
+  ResultsSetTest("Cyclic","%d cycles of %d bytes",cycleReps,cycleLen);
 
   Rand r(483723);
 
@@ -330,6 +335,7 @@ bool TextKeyTest ( hashfunc<hashtype> hash, const char * prefix, const char * co
   printf("Keyset 'Text' - keys of form \"%s[",prefix);
   for(int i = 0; i < corelen; i++) printf("X");		
   printf("]%s\" - %d keys\n",suffix,keycount);
+  ResultsSetTest("Text","prefix \"%s\", %d core characters, suffix \"%s\"",prefix,corelen,suffix);
 
   uint8_t * key = new uint8_t[keybytes+1];
 
@@ -379,6 +385,7 @@ bool ZeroKeyTest ( pfHash hash, bool drawDiagram )
   int keycount = 64*1024;
 
   printf("Keyset 'Zeroes' - %d keys\n",keycount);
+  ResultsSetTest("Zeroes","");
 
   unsigned char * nullblock = new unsigned char[keycount];
   memset(nullblock,0,keycount);
@@ -412,6 +419,7 @@ template < typename hashtype >
 bool SeedTest ( pfHash hash, int keycount, bool drawDiagram )
 {
   printf("Keyset 'Seed' - %d keys\n",keycount);
+  ResultsSetTest("Seed","");
 
   const char * text = "The quick brown fox jumps over the lazy dog";
   const int len = (int)strlen(text);
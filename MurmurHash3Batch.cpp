@@ -0,0 +1,239 @@
+#include "MurmurHash3Batch.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+// GCC 12 flags the deliberately undefined results inside the AVX-512
+// shift/rotate/insert intrinsics as uninitialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#endif
+
+//-----------------------------------------------------------------------------
+// Scalar reference - also does the leftovers of the SIMD versions
+
+void MurmurHash3_x86_32_batch ( const void * const * keys, const int * lens,
+                                int count, uint32_t seed, uint32_t * out )
+{
+  for(int i = 0; i < count; i++)
+  {
+    MurmurHash3_x86_32(keys[i],lens[i],seed,&out[i]);
+  }
+}
+
+//----------
+// The unmixed tail word of one key - mixing a zero word is a no-op, so keys
+// without a tail need no special case.
+
+static uint32_t TailWord ( const void * key, int len )
+{
+  const uint8_t * tail = (const uint8_t*)key + (len & ~3);
+
+  uint32_t k1 = 0;
+
+  switch(len & 3)
+  {
+  case 3: k1 ^= tail[2] << 16;
+  case 2: k1 ^= tail[1] << 8;
+  case 1: k1 ^= tail[0];
+  };
+
+  return k1;
+}
+
+//-----------------------------------------------------------------------------
+// Each lane walks its own key. Block i of every lane is fetched with one
+// gather using the key pointers themselves as 64-bit indices off a null
+// base; lanes with fewer than i+1 blocks are masked out of the gather, so
+// they never touch memory past their key, and keep their hash unchanged.
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+__attribute__((target("avx2")))
+static inline __m256i rotl32_avx2 ( __m256i x, int r )
+{
+  return _mm256_or_si256(_mm256_slli_epi32(x,r),_mm256_srli_epi32(x,32 - r));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mixk_avx2 ( __m256i k1 )
+{
+  k1 = _mm256_mullo_epi32(k1,_mm256_set1_epi32(0xcc9e2d51));
+  k1 = rotl32_avx2(k1,15);
+  k1 = _mm256_mullo_epi32(k1,_mm256_set1_epi32(0x1b873593));
+
+  return k1;
+}
+
+__attribute__((target("avx2")))
+static void MurmurHash3_x86_32_x8 ( const void * const * keys, const int * lens,
+                                    uint32_t seed, uint32_t * out )
+{
+  __m256i len = _mm256_loadu_si256((const __m256i*)lens);
+  __m256i nblocks = _mm256_srli_epi32(len,2);
+
+  int maxblocks = 0;
+
+  for(int j = 0; j < 8; j++) if(lens[j] / 4 > maxblocks) maxblocks = lens[j] / 4;
+
+  __m256i ptrlo = _mm256_loadu_si256((const __m256i*)(keys + 0));
+  __m256i ptrhi = _mm256_loadu_si256((const __m256i*)(keys + 4));
+
+  const __m256i four = _mm256_set1_epi64x(4);
+
+  __m256i h1 = _mm256_set1_epi32(seed);
+
+  for(int i = 0; i < maxblocks; i++)
+  {
+    __m256i live = _mm256_cmpgt_epi32(nblocks,_mm256_set1_epi32(i));
+
+    __m128i klo = _mm256_mask_i64gather_epi32(_mm_setzero_si128(),(const int*)0,ptrlo,
+                                              _mm256_castsi256_si128(live),1);
+    __m128i khi = _mm256_mask_i64gather_epi32(_mm_setzero_si128(),(const int*)0,ptrhi,
+                                              _mm256_extracti128_si256(live,1),1);
+
+    __m256i k1 = mixk_avx2(_mm256_inserti128_si256(_mm256_castsi128_si256(klo),khi,1));
+
+    __m256i h = _mm256_xor_si256(h1,k1);
+    h = rotl32_avx2(h,13);
+    h = _mm256_add_epi32(_mm256_add_epi32(h,_mm256_slli_epi32(h,2)),_mm256_set1_epi32(0xe6546b64));
+
+    h1 = _mm256_blendv_epi8(h1,h,live);
+
+    ptrlo = _mm256_add_epi64(ptrlo,four);
+    ptrhi = _mm256_add_epi64(ptrhi,four);
+  }
+
+  uint32_t tail[8];
+
+  for(int j = 0; j < 8; j++) tail[j] = TailWord(keys[j],lens[j]);
+
+  h1 = _mm256_xor_si256(h1,mixk_avx2(_mm256_loadu_si256((const __m256i*)tail)));
+
+  // finalization
+
+  h1 = _mm256_xor_si256(h1,len);
+
+  h1 = _mm256_xor_si256(h1,_mm256_srli_epi32(h1,16));
+  h1 = _mm256_mullo_epi32(h1,_mm256_set1_epi32(0x85ebca6b));
+  h1 = _mm256_xor_si256(h1,_mm256_srli_epi32(h1,13));
+  h1 = _mm256_mullo_epi32(h1,_mm256_set1_epi32(0xc2b2ae35));
+  h1 = _mm256_xor_si256(h1,_mm256_srli_epi32(h1,16));
+
+  _mm256_storeu_si256((__m256i*)out,h1);
+}
+
+void MurmurHash3_x86_32_batch_avx2 ( const void * const * keys, const int * lens,
+                                     int count, uint32_t seed, uint32_t * out )
+{
+  int i = 0;
+
+  for(; i + 8 <= count; i += 8)
+  {
+    MurmurHash3_x86_32_x8(keys + i,lens + i,seed,out + i);
+  }
+
+  MurmurHash3_x86_32_batch(keys + i,lens + i,count - i,seed,out + i);
+}
+
+//----------
+
+__attribute__((target("avx512f")))
+static inline __m512i mixk_avx512 ( __m512i k1 )
+{
+  k1 = _mm512_mullo_epi32(k1,_mm512_set1_epi32(0xcc9e2d51));
+  k1 = _mm512_rol_epi32(k1,15);
+  k1 = _mm512_mullo_epi32(k1,_mm512_set1_epi32(0x1b873593));
+
+  return k1;
+}
+
+__attribute__((target("avx512f")))
+static void MurmurHash3_x86_32_x16 ( const void * const * keys, const int * lens,
+                                     uint32_t seed, uint32_t * out )
+{
+  __m512i len = _mm512_loadu_si512((const void*)lens);
+  __m512i nblocks = _mm512_srli_epi32(len,2);
+
+  int maxblocks = 0;
+
+  for(int j = 0; j < 16; j++) if(lens[j] / 4 > maxblocks) maxblocks = lens[j] / 4;
+
+  __m512i ptrlo = _mm512_loadu_si512((const void*)(keys + 0));
+  __m512i ptrhi = _mm512_loadu_si512((const void*)(keys + 8));
+
+  const __m512i four = _mm512_set1_epi64(4);
+
+  __m512i h1 = _mm512_set1_epi32(seed);
+
+  for(int i = 0; i < maxblocks; i++)
+  {
+    __mmask16 live = _mm512_cmpgt_epi32_mask(nblocks,_mm512_set1_epi32(i));
+
+    __m256i klo = _mm512_mask_i64gather_epi32(_mm256_setzero_si256(),(__mmask8)live,
+                                              ptrlo,(const void*)0,1);
+    __m256i khi = _mm512_mask_i64gather_epi32(_mm256_setzero_si256(),(__mmask8)(live >> 8),
+                                              ptrhi,(const void*)0,1);
+
+    __m512i k1 = mixk_avx512(_mm512_inserti64x4(_mm512_castsi256_si512(klo),khi,1));
+
+    __m512i h = _mm512_xor_si512(h1,k1);
+    h = _mm512_rol_epi32(h,13);
+    h = _mm512_add_epi32(_mm512_add_epi32(h,_mm512_slli_epi32(h,2)),_mm512_set1_epi32(0xe6546b64));
+
+    h1 = _mm512_mask_mov_epi32(h1,live,h);
+
+    ptrlo = _mm512_add_epi64(ptrlo,four);
+    ptrhi = _mm512_add_epi64(ptrhi,four);
+  }
+
+  uint32_t tail[16];
+
+  for(int j = 0; j < 16; j++) tail[j] = TailWord(keys[j],lens[j]);
+
+  h1 = _mm512_xor_si512(h1,mixk_avx512(_mm512_loadu_si512((const void*)tail)));
+
+  // finalization
+
+  h1 = _mm512_xor_si512(h1,len);
+
+  h1 = _mm512_xor_si512(h1,_mm512_srli_epi32(h1,16));
+  h1 = _mm512_mullo_epi32(h1,_mm512_set1_epi32(0x85ebca6b));
+  h1 = _mm512_xor_si512(h1,_mm512_srli_epi32(h1,13));
+  h1 = _mm512_mullo_epi32(h1,_mm512_set1_epi32(0xc2b2ae35));
+  h1 = _mm512_xor_si512(h1,_mm512_srli_epi32(h1,16));
+
+  _mm512_storeu_si512((void*)out,h1);
+}
+
+void MurmurHash3_x86_32_batch_avx512 ( const void * const * keys, const int * lens,
+                                       int count, uint32_t seed, uint32_t * out )
+{
+  int i = 0;
+
+  for(; i + 16 <= count; i += 16)
+  {
+    MurmurHash3_x86_32_x16(keys + i,lens + i,seed,out + i);
+  }
+
+  MurmurHash3_x86_32_batch_avx2(keys + i,lens + i,count - i,seed,out + i);
+}
+
+#else
+
+void MurmurHash3_x86_32_batch_avx2 ( const void * const * keys, const int * lens,
+                                     int count, uint32_t seed, uint32_t * out )
+{
+  MurmurHash3_x86_32_batch(keys,lens,count,seed,out);
+}
+
+void MurmurHash3_x86_32_batch_avx512 ( const void * const * keys, const int * lens,
+                                       int count, uint32_t seed, uint32_t * out )
+{
+  MurmurHash3_x86_32_batch(keys,lens,count,seed,out);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,27 @@
+//-----------------------------------------------------------------------------
+// Multi-buffer MurmurHash3_x86_32 - hashes many independent keys at once,
+// one key per 32-bit SIMD lane, 8 lanes with AVX2 and 16 with AVX-512. Each
+// lane has its own pointer and length; lanes whose keys run out of blocks
+// are masked off while the longer ones finish. Results are identical to
+// calling MurmurHash3_x86_32 on each key.
+
+#pragma once
+
+#include "MurmurHash3.h"
+
+// Hashes keys[i] (lens[i] bytes) into out[i] for i in [0,count), all with
+// the same seed. Batches of 8 or 16 go through the SIMD lanes, any leftover
+// keys through the scalar function.
+
+typedef void (*pfBatchHash) ( const void * const * keys, const int * lens, int count, uint32_t seed, uint32_t * out );
+
+void MurmurHash3_x86_32_batch        ( const void * const * keys, const int * lens, int count, uint32_t seed, uint32_t * out );
+
+// These need AVX2 and AVX-512 (F/BW/VL) respectively - check GetCPUFeatures
+// before calling them. Where the compiler can't target them they fall back
+// to the scalar batch.
+
+void MurmurHash3_x86_32_batch_avx2   ( const void * const * keys, const int * lens, int count, uint32_t seed, uint32_t * out );
+void MurmurHash3_x86_32_batch_avx512 ( const void * const * keys, const int * lens, int count, uint32_t seed, uint32_t * out );
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,206 @@
+#include "PerfCounters.h"
+
+#include <stdio.h>
+#include <string.h>
+
+PerfCounters::PerfCounters ( void ) : m_failed(false), m_leader(-1), m_nslots(0)
+{
+  for(int i = 0; i < PERFCTR_COUNT; i++)
+  {
+    m_fds[i] = -1;
+    m_slot[i] = -1;
+  }
+}
+
+PerfCounters::~PerfCounters ( void )
+{
+  close();
+}
+
+#if defined(__linux__)
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static int perf_event_open ( perf_event_attr * attr, int group )
+{
+  return (int)syscall(__NR_perf_event_open,attr,0,-1,group,0);
+}
+
+// There's no generic micro-op event, so pick the vendor's raw encoding -
+// UOPS_ISSUED.ANY on Intel, retired ops on AMD.
+
+static bool UopsConfig ( uint64_t & config )
+{
+  uint32_t regs[4];
+
+  cpuid(0,0,regs);
+
+  if(memcmp(&regs[1],"Genu",4) == 0) { config = 0x010E; return true; }
+  if(memcmp(&regs[1],"Auth",4) == 0) { config = 0x00C1; return true; }
+
+  return false;
+}
+
+bool PerfCounters::open ( void )
+{
+  if(active()) return true;
+  if(m_failed) return false;
+
+  uint32_t types[PERFCTR_COUNT];
+  uint64_t configs[PERFCTR_COUNT];
+
+  types[PERFCTR_INSTRUCTIONS]  = PERF_TYPE_HARDWARE;
+  configs[PERFCTR_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS;
+
+  types[PERFCTR_CYCLES]  = PERF_TYPE_HARDWARE;
+  configs[PERFCTR_CYCLES] = PERF_COUNT_HW_CPU_CYCLES;
+
+  types[PERFCTR_BRANCH_MISSES]  = PERF_TYPE_HARDWARE;
+  configs[PERFCTR_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES;
+
+  types[PERFCTR_L1D_MISSES]  = PERF_TYPE_HW_CACHE;
+  configs[PERFCTR_L1D_MISSES] = PERF_COUNT_HW_CACHE_L1D |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+  types[PERFCTR_LLC_MISSES]  = PERF_TYPE_HARDWARE;
+  configs[PERFCTR_LLC_MISSES] = PERF_COUNT_HW_CACHE_MISSES;
+
+  types[PERFCTR_UOPS] = PERF_TYPE_RAW;
+  bool haveUops = UopsConfig(configs[PERFCTR_UOPS]);
+
+  // Cycles lead the group, as it's the event most likely to exist.
+
+  const int order[PERFCTR_COUNT] =
+  {
+    PERFCTR_CYCLES, PERFCTR_INSTRUCTIONS, PERFCTR_BRANCH_MISSES, PERFCTR_L1D_MISSES, PERFCTR_LLC_MISSES, PERFCTR_UOPS
+  };
+
+  for(int i = 0; i < PERFCTR_COUNT; i++)
+  {
+    int e = order[i];
+
+    if((e == PERFCTR_UOPS) && !haveUops) continue;
+
+    perf_event_attr attr;
+    memset(&attr,0,sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = types[e];
+    attr.config = configs[e];
+    attr.disabled = (m_leader == -1) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = perf_event_open(&attr,m_leader);
+
+    if(fd == -1)
+    {
+      if(m_leader == -1)
+      {
+        printf("WARNING: perf_event_open failed, hardware counters unavailable\n");
+        m_failed = true;
+        return false;
+      }
+
+      continue;
+    }
+
+    if(m_leader == -1) m_leader = fd;
+
+    m_fds[e] = fd;
+    m_slot[e] = m_nslots++;
+  }
+
+  return true;
+}
+
+void PerfCounters::close ( void )
+{
+  for(int i = 0; i < PERFCTR_COUNT; i++)
+  {
+    if(m_fds[i] != -1) ::close(m_fds[i]);
+
+    m_fds[i] = -1;
+    m_slot[i] = -1;
+  }
+
+  m_leader = -1;
+  m_nslots = 0;
+}
+
+void PerfCounters::reset ( void )
+{
+  if(active()) ioctl(m_leader,PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::start ( void )
+{
+  if(active()) ioctl(m_leader,PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::stop ( void )
+{
+  if(active()) ioctl(m_leader,PERF_EVENT_IOC_DISABLE,PERF_IOC_FLAG_GROUP);
+}
+
+bool PerfCounters::read ( PerfCounts & out )
+{
+  memset(&out,0,sizeof(out));
+
+  if(!active()) return false;
+
+  // nr, time_enabled, time_running, value[nr]
+
+  uint64_t buf[3 + PERFCTR_COUNT];
+
+  if(::read(m_leader,buf,sizeof(buf)) < (ssize_t)(3 * sizeof(uint64_t))) return false;
+
+  uint64_t enabled = buf[1];
+  uint64_t running = buf[2];
+
+  // The group never made it onto the PMU (e.g. too many events for the
+  // available counters) - nothing to report.
+
+  if(running == 0) return false;
+
+  double scale = double(enabled) / double(running);
+
+  for(int i = 0; i < PERFCTR_COUNT; i++)
+  {
+    if(m_slot[i] == -1) continue;
+
+    out.value[i] = double(buf[3 + m_slot[i]]) * scale;
+    out.valid[i] = true;
+  }
+
+  return true;
+}
+
+#else
+
+bool PerfCounters::open ( void )
+{
+  if(!m_failed) printf("WARNING: Hardware counters are only supported on Linux\n");
+  m_failed = true;
+  return false;
+}
+
+void PerfCounters::close ( void ) {}
+void PerfCounters::reset ( void ) {}
+void PerfCounters::start ( void ) {}
+void PerfCounters::stop  ( void ) {}
+
+bool PerfCounters::read ( PerfCounts & out )
+{
+  memset(&out,0,sizeof(out));
+  return false;
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
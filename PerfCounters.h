@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Types.h"
+
+//-----------------------------------------------------------------------------
+// Hardware performance counters, read through Linux's perf_event_open. The
+// events are opened as a single group so the kernel always schedules them
+// onto the PMU together, and are only counted in user mode so the ioctls
+// that start and stop them don't show up in the results.
+
+// Events that a particular kernel/CPU/VM doesn't support are left out of the
+// group and reported as unavailable. On other platforms nothing is available.
+
+enum PerfCounter
+{
+  PERFCTR_INSTRUCTIONS,
+  PERFCTR_CYCLES,
+  PERFCTR_BRANCH_MISSES,
+  PERFCTR_L1D_MISSES,
+  PERFCTR_LLC_MISSES,
+  PERFCTR_UOPS,
+
+  PERFCTR_COUNT
+};
+
+struct PerfCounts
+{
+  double value[PERFCTR_COUNT];
+  bool   valid[PERFCTR_COUNT];
+};
+
+class PerfCounters
+{
+public:
+
+  PerfCounters ( void );
+  ~PerfCounters ( void );
+
+  bool open  ( void );
+  void close ( void );
+
+  bool active ( void ) const { return m_leader != -1; }
+
+  void reset ( void );
+  void start ( void );
+  void stop  ( void );
+
+  // Counts accumulated since the last reset(). If the PMU had to multiplex
+  // the group the values are scaled up to the full enabled time.
+
+  bool read ( PerfCounts & out );
+
+private:
+
+  bool m_failed;
+  int m_leader;
+  int m_fds[PERFCTR_COUNT];
+  int m_slot[PERFCTR_COUNT];
+  int m_nslots;
+};
+
+//-----------------------------------------------------------------------------
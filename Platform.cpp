@@ -1,6 +1,8 @@
 #include "Platform.h"
 
 #include <stdio.h>
+#include <algorithm> // for sort
+#include <vector>
 
 void testRDTSC ( void )
 {
@@ -9,34 +11,552 @@ void testRDTSC ( void )
   printf("%d",(int)temp);
 }
 
+//-----------------------------------------------------------------------------
+// CPUID leaf 0x80000007, EDX bit 8 - the TSC runs at a constant rate in all
+// P-, C- and T-states.
+
+bool HasInvariantTSC ( void )
+{
+  uint32_t regs[4];
+
+  cpuid(0x80000000,0,regs);
+
+  if(regs[0] < 0x80000007) return false;
+
+  cpuid(0x80000007,0,regs);
+
+  return (regs[3] & (1 << 8)) != 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void FlushCacheLines ( const void * ptr, size_t len )
+{
+  const char * p = (const char*)(uintptr_t(ptr) & ~uintptr_t(63));
+  const char * end = (const char*)ptr + len;
+
+  for(; p < end; p += 64)
+  {
+#if defined(_MSC_VER)
+    _mm_clflush(p);
+#else
+    __asm__ volatile ("clflush %0" : : "m" (*p));
+#endif
+  }
+
+#if defined(_MSC_VER)
+  _mm_mfence();
+#else
+  __asm__ volatile ("mfence" : : : "memory");
+#endif
+}
+
 #if defined(_MSC_VER)
 
 #include <windows.h>
 
-void SetAffinity ( int cpu )
+bool SetAffinity ( int cpu )
 {
-  SetProcessAffinityMask(GetCurrentProcess(),cpu);
+  bool ok = SetProcessAffinityMask(GetCurrentProcess(),DWORD_PTR(1) << cpu) != 0;
   SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+  if(!ok) printf("WARNING: Could not pin to cpu %d\n",cpu);
+
+  return ok;
+}
+
+int AffinityLimit ( void )
+{
+  return int(sizeof(DWORD_PTR) * 8);
+}
+
+// Wall-clock time in seconds
+
+double GetWallTime ( void )
+{
+  static LARGE_INTEGER freq = { 0 };
+  LARGE_INTEGER t;
+
+  if(freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+
+  QueryPerformanceCounter(&t);
+
+  return double(t.QuadPart) / double(freq.QuadPart);
+}
+
+void SleepMillis ( int ms )
+{
+  Sleep(ms);
+}
+
+//----------
+
+int GetCPUOrder ( int * cpus, int maxcpus, int & cores )
+{
+  DWORD bytes = 0;
+
+  GetLogicalProcessorInformation(NULL,&bytes);
+
+  std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(bytes / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+
+  if((bytes == 0) || !GetLogicalProcessorInformation(&info[0],&bytes))
+  {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+
+    int count = std::min((int)si.dwNumberOfProcessors,maxcpus);
+    for(int i = 0; i < count; i++) cpus[i] = i;
+
+    cores = count;
+    return count;
+  }
+
+  info.resize(bytes / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+  // Pass 0 takes the lowest logical CPU of each core, pass 1 the rest
+
+  int count = 0;
+  cores = 0;
+
+  for(int pass = 0; pass < 2; pass++)
+  {
+    for(size_t i = 0; i < info.size(); i++)
+    {
+      if(info[i].Relationship != RelationProcessorCore) continue;
+
+      if(pass == 0) cores++;
+
+      ULONG_PTR mask = info[i].ProcessorMask;
+      bool first = true;
+
+      for(int cpu = 0; cpu < (int)(sizeof(mask) * 8); cpu++)
+      {
+        if(!(mask & (ULONG_PTR(1) << cpu))) continue;
+
+        if((first == (pass == 0)) && (count < maxcpus)) cpus[count++] = cpu;
+
+        first = false;
+      }
+    }
+  }
+
+  return count;
+}
+
+struct ThreadStart
+{
+  ThreadFunc fn;
+  void * arg;
+};
+
+static DWORD WINAPI ThreadMain ( LPVOID p )
+{
+  ThreadStart start = *(ThreadStart*)p;
+  delete (ThreadStart*)p;
+
+  start.fn(start.arg);
+
+  return 0;
+}
+
+void * StartThread ( ThreadFunc fn, void * arg, int cpu )
+{
+  ThreadStart * start = new ThreadStart;
+  start->fn = fn;
+  start->arg = arg;
+
+  HANDLE thread = CreateThread(NULL,0,ThreadMain,start,CREATE_SUSPENDED,NULL);
+
+  SetThreadAffinityMask(thread,DWORD_PTR(1) << cpu);
+  ResumeThread(thread);
+
+  return thread;
+}
+
+void JoinThread ( void * thread )
+{
+  WaitForSingleObject((HANDLE)thread,INFINITE);
+  CloseHandle((HANDLE)thread);
+}
+
+//----------
+
+int64_t GetCacheSize ( int level )
+{
+  DWORD bytes = 0;
+
+  GetLogicalProcessorInformation(NULL,&bytes);
+
+  if(bytes == 0) return 0;
+
+  std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(bytes / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+  if(!GetLogicalProcessorInformation(&info[0],&bytes)) return 0;
+
+  for(size_t i = 0; i < info.size(); i++)
+  {
+    if(info[i].Relationship != RelationCache) continue;
+
+    CACHE_DESCRIPTOR & c = info[i].Cache;
+
+    if((c.Level == level) && (c.Type != CacheInstruction)) return c.Size;
+  }
+
+  return 0;
+}
+
+//----------
+
+const void * MapFile ( const char * filename, int64_t & size )
+{
+  size = 0;
+
+  HANDLE file = CreateFileA(filename,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+
+  if(file == INVALID_HANDLE_VALUE) return NULL;
+
+  LARGE_INTEGER length;
+
+  if(!GetFileSizeEx(file,&length) || (length.QuadPart == 0))
+  {
+    CloseHandle(file);
+    return NULL;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file,NULL,PAGE_READONLY,0,0,NULL);
+
+  CloseHandle(file);
+
+  if(mapping == NULL) return NULL;
+
+  // The view keeps the mapping alive after its handle is closed
+
+  const void * data = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+
+  CloseHandle(mapping);
+
+  if(data) size = length.QuadPart;
+
+  return data;
+}
+
+void UnmapFile ( const void * data, int64_t /*size*/ )
+{
+  if(data) UnmapViewOfFile(data);
 }
 
 #else
 
 #include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Read a short text file such as a sysfs attribute into 'text'
 
-void SetAffinity ( int /*cpu*/ )
+static bool ReadSysFile ( const char * path, char * text, int size )
+{
+  FILE * f = fopen(path,"r");
+
+  if(f == NULL) return false;
+
+  bool ok = fgets(text,size,f) != NULL;
+
+  fclose(f);
+
+  return ok;
+}
+
+bool SetAffinity ( int cpu )
 {
 #ifndef __CYGWIN__
   cpu_set_t mask;
     
   CPU_ZERO(&mask);
     
-  CPU_SET(2,&mask);
+  CPU_SET(cpu,&mask);
     
   if( sched_setaffinity(0,sizeof(mask),&mask) == -1)
   {
-    printf("WARNING: Could not set CPU affinity\n");
+    printf("WARNING: Could not pin to cpu %d\n",cpu);
+    return false;
   }
 #endif
+
+  return true;
 }
 
+int AffinityLimit ( void )
+{
+#ifdef CPU_SETSIZE
+  return CPU_SETSIZE;
+#else
+  return 64;
 #endif
+}
+
+// Wall-clock time in seconds. CLOCK_MONOTONIC_RAW isn't slewed by NTP, so
+// it's the best reference we have for the TSC rate.
+
+double GetWallTime ( void )
+{
+  timespec t;
+
+#ifdef CLOCK_MONOTONIC_RAW
+  clock_gettime(CLOCK_MONOTONIC_RAW,&t);
+#else
+  clock_gettime(CLOCK_MONOTONIC,&t);
+#endif
+
+  return double(t.tv_sec) + double(t.tv_nsec) * 1.0e-9;
+}
+
+void SleepMillis ( int ms )
+{
+  usleep(ms * 1000);
+}
+
+//----------
+
+// Group logical CPUs by (package, core) using the sysfs topology. Without
+// topology information every CPU is treated as its own core.
+
+int GetCPUOrder ( int * cpus, int maxcpus, int & cores )
+{
+  long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+
+  std::vector<int> online;
+  std::vector<int> coreids;
+
+  for(int cpu = 0; cpu < ncpus; cpu++)
+  {
+    char path[128];
+    char text[64];
+
+    snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d/online",cpu);
+    if(ReadSysFile(path,text,sizeof(text)) && (atoi(text) == 0)) continue;
+
+    int package = 0;
+    int core = cpu;
+
+    snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d/topology/physical_package_id",cpu);
+    if(ReadSysFile(path,text,sizeof(text))) package = atoi(text);
+
+    snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d/topology/core_id",cpu);
+    if(ReadSysFile(path,text,sizeof(text))) core = atoi(text);
+
+    online.push_back(cpu);
+    coreids.push_back((package << 16) | core);
+  }
+
+  // Pass 0 takes the first logical CPU seen for each core, pass 1 the rest
+
+  std::vector<int> seen;
+  std::vector<bool> taken(online.size(),false);
+
+  int count = 0;
+
+  for(size_t i = 0; i < online.size(); i++)
+  {
+    if(std::find(seen.begin(),seen.end(),coreids[i]) != seen.end()) continue;
+
+    seen.push_back(coreids[i]);
+    taken[i] = true;
+
+    if(count < maxcpus) cpus[count++] = online[i];
+  }
+
+  for(size_t i = 0; i < online.size(); i++)
+  {
+    if(!taken[i] && (count < maxcpus)) cpus[count++] = online[i];
+  }
+
+  cores = (int)seen.size();
+
+  return count;
+}
+
+struct ThreadStart
+{
+  ThreadFunc fn;
+  void * arg;
+  int cpu;
+};
+
+static void * ThreadMain ( void * p )
+{
+  ThreadStart start = *(ThreadStart*)p;
+  delete (ThreadStart*)p;
+
+#ifndef __CYGWIN__
+  cpu_set_t mask;
+
+  CPU_ZERO(&mask);
+  CPU_SET(start.cpu,&mask);
+
+  if(sched_setaffinity(0,sizeof(mask),&mask) == -1)
+  {
+    printf("WARNING: Could not pin thread to CPU %d\n",start.cpu);
+  }
+#endif
+
+  start.fn(start.arg);
+
+  return NULL;
+}
+
+void * StartThread ( ThreadFunc fn, void * arg, int cpu )
+{
+  ThreadStart * start = new ThreadStart;
+  start->fn = fn;
+  start->arg = arg;
+  start->cpu = cpu;
+
+  pthread_t * thread = new pthread_t;
+
+  if(pthread_create(thread,NULL,ThreadMain,start) != 0)
+  {
+    printf("WARNING: Could not create thread\n");
+    delete start;
+    delete thread;
+    return NULL;
+  }
+
+  return thread;
+}
+
+void JoinThread ( void * thread )
+{
+  if(thread == NULL) return;
+
+  pthread_join(*(pthread_t*)thread,NULL);
+
+  delete (pthread_t*)thread;
+}
+
+//----------
+
+// Read the cache geometry from sysfs, which unlike sysconf() also works for
+// caches that glibc doesn't know how to decode.
+
+int64_t GetCacheSize ( int level )
+{
+  for(int index = 0; index < 8; index++)
+  {
+    char path[128];
+    char text[64];
+
+    snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%d/level",index);
+    if(!ReadSysFile(path,text,sizeof(text))) break;
+    if(atoi(text) != level) continue;
+
+    snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%d/type",index);
+    if(!ReadSysFile(path,text,sizeof(text))) continue;
+    if(strncmp(text,"Instruction",11) == 0) continue;
+
+    snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%d/size",index);
+    if(!ReadSysFile(path,text,sizeof(text))) continue;
+
+    char * suffix;
+    int64_t size = strtol(text,&suffix,10);
+
+    if(*suffix == 'K') size *= 1024;
+    if(*suffix == 'M') size *= 1024 * 1024;
+
+    return size;
+  }
+
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+  long size = 0;
+
+  if(level == 1) size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  if(level == 2) size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if(level == 3) size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+  if(size > 0) return size;
+#endif
+
+  return 0;
+}
+
+//----------
+
+const void * MapFile ( const char * filename, int64_t & size )
+{
+  size = 0;
+
+  int fd = open(filename,O_RDONLY);
+
+  if(fd == -1) return NULL;
+
+  struct stat st;
+
+  if((fstat(fd,&st) == -1) || (st.st_size == 0))
+  {
+    close(fd);
+    return NULL;
+  }
+
+  void * data = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+
+  close(fd);
+
+  if(data == MAP_FAILED) return NULL;
+
+  size = st.st_size;
+
+  return data;
+}
+
+void UnmapFile ( const void * data, int64_t size )
+{
+  if(data) munmap(const_cast<void*>(data),size);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// Measure the TSC rate by spinning on the wall clock for a few short
+// intervals and taking the median ratio, so a single preemption during
+// calibration doesn't skew every result. Only done once per run.
+
+double GetTimerFrequency ( void )
+{
+  static double freq = 0;
+
+  if(freq > 0) return freq;
+
+  const int rounds = 7;
+  const double interval = 0.02;
+
+  double ratios[rounds];
+
+  for(int i = 0; i < rounds; i++)
+  {
+    double t0 = GetWallTime();
+    uint64_t c0 = timer_start();
+
+    double t1;
+
+    do
+    {
+      t1 = GetWallTime();
+    }
+    while(t1 - t0 < interval);
+
+    uint64_t c1 = timer_end();
+
+    ratios[i] = double(c1 - c0) / (t1 - t0);
+  }
+
+  std::sort(ratios,ratios+rounds);
+
+  freq = ratios[rounds/2];
+
+  return freq;
+}
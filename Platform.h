@@ -3,7 +3,38 @@
 
 #pragma once
 
-void SetAffinity ( int cpu );
+// Pins the calling process to one logical CPU, returns false if it couldn't.
+// 'cpu' must be in [0,AffinityLimit()) - the affinity mask has no room for
+// anything past that.
+
+bool SetAffinity   ( int cpu );
+int  AffinityLimit ( void );
+
+//-----------------------------------------------------------------------------
+// Timestamp counter calibration. Modern x86 parts tick the TSC at a fixed
+// rate that has nothing to do with the current core clock, so we measure that
+// rate against the OS's monotonic clock once and use it to convert ticks to
+// wall-clock time.
+
+bool   HasInvariantTSC ( void );
+double GetTimerFrequency ( void );
+
+// Seconds from the OS's monotonic clock
+
+double GetWallTime ( void );
+void   SleepMillis ( int ms );
+
+//-----------------------------------------------------------------------------
+// Threads, for the scaling benchmarks. GetCPUOrder fills 'cpus' with the
+// online logical CPUs, one per physical core first and SMT siblings after
+// that, and returns how many there are. 'cores' receives the number of
+// physical cores. StartThread runs fn(arg) on a new thread pinned to 'cpu'.
+
+typedef void (*ThreadFunc) ( void * arg );
+
+int    GetCPUOrder ( int * cpus, int maxcpus, int & cores );
+void * StartThread ( ThreadFunc fn, void * arg, int cpu );
+void   JoinThread  ( void * thread );
 
 //-----------------------------------------------------------------------------
 // Microsoft Visual Studio
@@ -33,12 +64,44 @@ void SetAffinity ( int cpu );
 
 #define rdtsc() __rdtsc()
 
+// Serialized timestamp reads for bracketing timed code. The lfence before
+// the first read keeps earlier work from leaking into the timed region,
+// rdtscp + lfence after it waits for the timed code to retire and keeps
+// later work from starting early.
+
+inline uint64_t timer_start ( void )
+{
+  _mm_lfence();
+  return __rdtsc();
+}
+
+inline uint64_t timer_end ( void )
+{
+  unsigned int aux;
+  uint64_t t = __rdtscp(&aux);
+  _mm_lfence();
+  return t;
+}
+
+inline void cpuid ( uint32_t leaf, uint32_t subleaf, uint32_t regs[4] )
+{
+  int r[4];
+  __cpuidex(r,(int)leaf,(int)subleaf);
+  regs[0] = r[0]; regs[1] = r[1]; regs[2] = r[2]; regs[3] = r[3];
+}
+
+inline uint64_t xgetbv ( uint32_t index )
+{
+  return _xgetbv(index);
+}
+
 //-----------------------------------------------------------------------------
 // Other compilers
 
 #else	//	defined(_MSC_VER)
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define	FORCE_INLINE __attribute__((always_inline))
 #define	NEVER_INLINE __attribute__((noinline))
@@ -86,9 +149,58 @@ __inline__ unsigned long long int rdtsc()
 #endif
 }
 
+// Serialized timestamp reads for bracketing timed code. The lfence before
+// the first read keeps earlier work from leaking into the timed region,
+// rdtscp + lfence after it waits for the timed code to retire and keeps
+// later work from starting early.
+
+__inline__ uint64_t timer_start ( void )
+{
+  unsigned int a, d;
+  __asm__ volatile ("lfence\n\trdtsc" : "=a" (a), "=d" (d) : : "memory");
+  return (uint64_t)a | ((uint64_t)d << 32);
+}
+
+__inline__ uint64_t timer_end ( void )
+{
+  unsigned int a, d, c;
+  __asm__ volatile ("rdtscp\n\tlfence" : "=a" (a), "=d" (d), "=c" (c) : : "memory");
+  return (uint64_t)a | ((uint64_t)d << 32);
+}
+
+__inline__ void cpuid ( uint32_t leaf, uint32_t subleaf, uint32_t regs[4] )
+{
+  __asm__ volatile ("cpuid" : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+                            : "a" (leaf), "c" (subleaf));
+}
+
+// Only valid when cpuid reports OSXSAVE
+
+__inline__ uint64_t xgetbv ( uint32_t index )
+{
+  uint32_t a, d;
+  __asm__ volatile ("xgetbv" : "=a" (a), "=d" (d) : "c" (index));
+  return (uint64_t)a | ((uint64_t)d << 32);
+}
+
 #include <strings.h>
 #define _stricmp strcasecmp
 
 #endif	//	!defined(_MSC_VER)
 
 //-----------------------------------------------------------------------------
+// Cache control. FlushCacheLines evicts [ptr,ptr+len) from every level of
+// the cache hierarchy. GetCacheSize returns the size in bytes of the given
+// data/unified cache level (1-3), or 0 if it can't be determined.
+
+void FlushCacheLines ( const void * ptr, size_t len );
+int64_t GetCacheSize ( int level );
+
+//-----------------------------------------------------------------------------
+// Read-only memory map of a whole file. Returns NULL if the file can't be
+// opened or is empty.
+
+const void * MapFile ( const char * filename, int64_t & size );
+void UnmapFile ( const void * data, int64_t size );
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,203 @@
+#include "Results.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+
+//-----------------------------------------------------------------------------
+
+static FILE * g_results = NULL;
+
+static std::string g_resultHash = "unknown";
+static std::string g_resultVariant;
+static std::string g_resultTest = "unknown";
+static std::string g_resultParams;
+
+static double g_resultClock = 0;   // start of the current test or record
+
+static std::string g_record;
+static bool g_recordOpen = false;
+
+//----------
+
+static void AppendString ( std::string & s, const char * value )
+{
+  s += '"';
+
+  for(const unsigned char * c = (const unsigned char*)value; *c; c++)
+  {
+    switch(*c)
+    {
+    case '"':  s += "\\\""; break;
+    case '\\': s += "\\\\"; break;
+    case '\n': s += "\\n";  break;
+    case '\r': s += "\\r";  break;
+    case '\t': s += "\\t";  break;
+    default:
+      if(*c < 0x20)
+      {
+        char esc[8];
+        snprintf(esc,sizeof(esc),"\\u%04x",*c);
+        s += esc;
+      }
+      else
+      {
+        s += (char)*c;
+      }
+    }
+  }
+
+  s += '"';
+}
+
+static void AppendKey ( const char * key )
+{
+  g_record += ',';
+  AppendString(g_record,key);
+  g_record += ':';
+}
+
+//-----------------------------------------------------------------------------
+
+bool ResultsOpen ( const char * filename )
+{
+  ResultsClose();
+
+  g_results = fopen(filename,"w");
+
+  if(g_results == NULL)
+  {
+    printf("Can't write results file '%s'\n",filename);
+    return false;
+  }
+
+  g_resultClock = GetWallTime();
+
+  return true;
+}
+
+void ResultsClose ( void )
+{
+  if(g_results) fclose(g_results);
+
+  g_results = NULL;
+}
+
+void ResultsSetHash ( const char * name, const char * variant )
+{
+  g_resultHash = name;
+  g_resultVariant = variant ? variant : "";
+}
+
+void ResultsSetTest ( const char * test, const char * paramfmt, ... )
+{
+  if(g_results == NULL) return;
+
+  char params[256];
+
+  va_list args;
+  va_start(args,paramfmt);
+  vsnprintf(params,sizeof(params),paramfmt,args);
+  va_end(args);
+
+  g_resultTest = test;
+  g_resultParams = params;
+  g_resultClock = GetWallTime();
+}
+
+//----------
+
+void ResultBegin ( void )
+{
+  if(g_results == NULL) return;
+
+  g_record = "{\"hash\":";
+  AppendString(g_record,g_resultHash.c_str());
+
+  if(!g_resultVariant.empty())
+  {
+    AppendKey("variant");
+    AppendString(g_record,g_resultVariant.c_str());
+  }
+
+  AppendKey("test");
+  AppendString(g_record,g_resultTest.c_str());
+  AppendKey("params");
+  AppendString(g_record,g_resultParams.c_str());
+
+  g_recordOpen = true;
+}
+
+void ResultInt ( const char * key, int64_t value )
+{
+  if(!g_recordOpen) return;
+
+  char buf[32];
+  snprintf(buf,sizeof(buf),"%lld",(long long)value);
+
+  AppendKey(key);
+  g_record += buf;
+}
+
+// JSON has no NaN or infinity, so those come out as null
+
+void ResultDouble ( const char * key, double value )
+{
+  if(!g_recordOpen) return;
+
+  char buf[32];
+
+  if(isfinite(value)) snprintf(buf,sizeof(buf),"%.9g",value);
+  else                snprintf(buf,sizeof(buf),"null");
+
+  AppendKey(key);
+  g_record += buf;
+}
+
+void ResultString ( const char * key, const char * value )
+{
+  if(!g_recordOpen) return;
+
+  AppendKey(key);
+  AppendString(g_record,value);
+}
+
+void ResultBool ( const char * key, bool value )
+{
+  if(!g_recordOpen) return;
+
+  AppendKey(key);
+  g_record += value ? "true" : "false";
+}
+
+// Elapsed time runs from ResultsSetTest or the previous record, whichever
+// came last - for tests that write several records, each record gets the
+// time spent producing it.
+
+void ResultEnd ( void )
+{
+  if(!g_recordOpen) return;
+
+  double now = GetWallTime();
+
+  ResultDouble("elapsed",now - g_resultClock);
+
+  g_resultClock = now;
+
+  char stamp[32];
+  time_t t = time(NULL);
+  strftime(stamp,sizeof(stamp),"%Y-%m-%dT%H:%M:%SZ",gmtime(&t));
+
+  ResultString("time",stamp);
+
+  g_record += "}\n";
+
+  fputs(g_record.c_str(),g_results);
+  fflush(g_results);
+
+  g_recordOpen = false;
+}
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// Machine-readable results. With a results file open, every test writes one
+// JSON object per line (JSON Lines) as soon as it finishes, so a long run can
+// be tailed, and an interrupted one still leaves every finished record behind.
+
+// Every record carries the hash, the test name and its parameters, the time
+// the test took and a timestamp; the rest depends on the test - key count
+// and expected/actual collisions for keyset tests, worst bias and the window
+// it was found in for distribution tests, cycles for speed tests.
+
+// All of these are no-ops when no results file is open.
+
+#pragma once
+
+#include "Types.h"
+
+bool ResultsOpen  ( const char * filename );
+void ResultsClose ( void );
+
+// The hash that subsequent records are filed under, and the variant of it
+// the dispatch layer picked, if it has more than one
+
+void ResultsSetHash ( const char * name, const char * variant = NULL );
+
+// The test that subsequent records belong to, e.g. "Sparse" with parameters
+// "64-bit keys, up to 5 bits set". Also restarts the test's elapsed-time clock.
+
+void ResultsSetTest ( const char * test, const char * paramfmt, ... );
+
+// A record is ResultBegin, any number of values, then ResultEnd, which writes
+// it out.
+
+void ResultBegin  ( void );
+void ResultInt    ( const char * key, int64_t value );
+void ResultDouble ( const char * key, double value );
+void ResultString ( const char * key, const char * value );
+void ResultBool   ( const char * key, bool value );
+void ResultEnd    ( void );
+
+//-----------------------------------------------------------------------------
@@ -1,11 +1,27 @@
 #include "SpeedTest.h"
 
 #include "Random.h"
+#include "PerfCounters.h"
+#include "EnergyCounters.h"
+#include "Histogram.h"
+#include "Hashes.h"
+#include "Spooky.h"
+#include "Baseline.h"
+#include "Results.h"
+#include "Dispatch.h"
+#include "MurmurHash3Batch.h"
 
 #include <stdio.h>   // for printf
 #include <memory.h>  // for memset
+#include <string.h>  // for strchr
 #include <math.h>    // for sqrt
-#include <algorithm> // for sort
+#include <algorithm> // for sort, nth_element
+#include <atomic>    // for the thread start handshake
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SMHASHER_STREAM_LOAD
+#include <immintrin.h> // for _mm_stream_load_si128
+#endif
 
 //-----------------------------------------------------------------------------
 // We view our timing values as a series of random variables V that has been
@@ -42,6 +58,18 @@ double CalcMean ( std::vector<double> & v, int a, int b )
   return mean;
 }
 
+// The speed tables report the median, which needs no outlier filtering.
+// Reorders 'v'.
+
+double CalcMedian ( std::vector<double> & v )
+{
+  if(v.empty()) return 0;
+
+  std::nth_element(v.begin(),v.begin() + v.size() / 2,v.end());
+
+  return v[v.size() / 2];
+}
+
 double CalcStdv ( std::vector<double> & v, int a, int b )
 {
   double mean = CalcMean(v,a,b);
@@ -143,29 +171,295 @@ void FilterOutliers2 ( std::vector<double> & v )
 }
 
 //-----------------------------------------------------------------------------
-// We really want the rdtsc() calls to bracket the function call as tightly
-// as possible, but that's hard to do portably. We'll try and get as close as
-// possible by marking the function as NEVER_INLINE (to keep the optimizer from
-// moving it) and marking the timing variables as "volatile register".
+// We really want the timestamp reads to bracket the function call as tightly
+// as possible. timer_start() and timer_end() are fenced so the CPU can't
+// overlap the hash with the surrounding code, and the function is marked
+// NEVER_INLINE to keep the optimizer from moving things across them.
 
 NEVER_INLINE int64_t timehash ( pfHash hash, const void * key, int len, int seed )
 {
-  volatile register int64_t begin,end;
-  
   uint32_t temp[16];
   
-  begin = rdtsc();
+  uint64_t begin = timer_start();
   
   hash(key,len,seed,temp);
   
-  end = rdtsc();
+  uint64_t end = timer_end();
   
   return end-begin;
 }
 
 //-----------------------------------------------------------------------------
+// Cycle counts are in TSC ticks. On parts with an invariant TSC those tick at
+// a fixed reference rate rather than the core clock, so we report wall-clock
+// figures derived from the measured TSC rate alongside them.
+
+void PrintTimerInfo ( void )
+{
+  double freq = GetTimerFrequency();
+
+  printf("Timestamp counter runs at %.3f GHz",freq / 1.0e9);
+  if(HasInvariantTSC()) printf(" (invariant)\n");
+  else printf(" - WARNING: TSC is not invariant, cycle counts may not match wall-clock time\n");
+
+  printf("Timer overhead %.2f cycles, call+timer overhead %.2f/%.2f/%.2f/%.2f cycles for 32/64/128/256-bit hashes\n",
+         GetTimerOverhead(),GetCallOverhead(4),GetCallOverhead(8),GetCallOverhead(16),GetCallOverhead(32));
+}
+
+double CyclesToNanos ( double cycles )
+{
+  return cycles * 1.0e9 / GetTimerFrequency();
+}
+
+//-----------------------------------------------------------------------------
+// Optional hardware counter readings. The counters are only enabled around
+// the timed call itself, so the per-trial re-randomization of the key doesn't
+// pollute them.
+
+bool g_speedCounters = false;
+
+PerfCounters g_counters;
+
+void PrintCounters ( const PerfCounts & c, double hashes, double bytes )
+{
+  const double kb = bytes / 1024.0;
+
+  bool any = false;
+
+  for(int i = 0; i < PERFCTR_COUNT; i++) any |= c.valid[i];
+
+  if(!any)
+  {
+    printf(" - counters n/a");
+    return;
+  }
+
+  if(c.valid[PERFCTR_INSTRUCTIONS] && c.valid[PERFCTR_CYCLES] && (c.value[PERFCTR_CYCLES] > 0))
+    printf(" - IPC %4.2f",c.value[PERFCTR_INSTRUCTIONS] / c.value[PERFCTR_CYCLES]);
+  else
+    printf(" - IPC  n/a");
+
+  if(c.valid[PERFCTR_BRANCH_MISSES])
+    printf(" - %7.3f br-miss/hash",c.value[PERFCTR_BRANCH_MISSES] / hashes);
+  else
+    printf(" -     n/a br-miss/hash");
+
+  if(c.valid[PERFCTR_L1D_MISSES])
+    printf(" - %8.3f L1D-miss/KB",c.value[PERFCTR_L1D_MISSES] / kb);
+  else
+    printf(" -      n/a L1D-miss/KB");
+
+  if(c.valid[PERFCTR_LLC_MISSES])
+    printf(" - %8.3f LLC-miss/KB",c.value[PERFCTR_LLC_MISSES] / kb);
+  else
+    printf(" -      n/a LLC-miss/KB");
+
+  if(c.valid[PERFCTR_UOPS])
+    printf(" - %9.1f uops/hash",c.value[PERFCTR_UOPS] / hashes);
+  else
+    printf(" -       n/a uops/hash");
+}
+
+//-----------------------------------------------------------------------------
+// Adaptive sampling. Rather than always running a fixed number of trials, we
+// periodically compute a 95% confidence interval for the median from the
+// order statistics at n/2 +/- 1.96*sqrt(n)/2, and stop as soon as it's
+// narrower than g_speedPrecision relative to the median, or the measurement
+// has run for g_speedTimeLimit seconds. The trial count passed to SpeedTest
+// is only an upper bound. Setting g_speedPrecision to 0 disables early exit.
+
+double g_speedPrecision = 0.01;
+double g_speedTimeLimit = 2.0;
+
+struct SpeedStats
+{
+  int mintrials;        // in - don't stop early before this many trials
+  int trials;           // trials actually run
+  double precision;     // relative width of the median's 95% confidence interval
+  Histogram * samples;  // if non-null, receives every sample
+};
+
+// Ranks (1-based) of the lower and upper bounds of the median's confidence
+// interval among n samples.
+
+void MedianRanks ( uint64_t n, uint64_t & ranklo, uint64_t & rankhi )
+{
+  double spread = 1.96 * sqrt(double(n)) / 2.0;
+
+  ranklo = (uint64_t)std::max(1.0,floor(n / 2.0 - spread));
+  rankhi = (uint64_t)std::min(double(n),ceil(n / 2.0 + spread) + 1);
+}
+
+// Returns the relative CI width. Histogram samples only resolve to a bucket,
+// so an interval that spans no more than two adjacent buckets is as tight as
+// we can measure and counts as converged.
+
+double MedianPrecision ( const Histogram & h, bool & converged )
+{
+  uint64_t ranklo, rankhi;
+
+  MedianRanks(h.count(),ranklo,rankhi);
+
+  double median = h.percentile(50);
+  double lo = h.rank(ranklo);
+  double hi = h.rank(rankhi);
+
+  double precision = (median > 0) ? (hi - lo) / median : 0;
+
+  converged = (precision <= g_speedPrecision) ||
+              (Histogram::index((uint64_t)hi) - Histogram::index((uint64_t)lo) <= 1);
+
+  return precision;
+}
+
+// Same, from the exact samples. Used when the caller didn't ask for a
+// histogram and we have them all anyway - for large blocks the histogram's
+// 1.5% bucket width is coarser than the precision we're asking for.
+
+double MedianPrecision ( const std::vector<double> & times, bool & converged )
+{
+  std::vector<double> v(times);
+
+  uint64_t ranklo, rankhi;
+
+  MedianRanks(v.size(),ranklo,rankhi);
+
+  std::nth_element(v.begin(),v.begin() + (ranklo - 1),v.end());
+  double lo = v[ranklo - 1];
+
+  std::nth_element(v.begin(),v.begin() + (v.size() / 2),v.end());
+  double median = v[v.size() / 2];
+
+  std::nth_element(v.begin(),v.begin() + (rankhi - 1),v.end());
+  double hi = v[rankhi - 1];
+
+  double precision = (median > 0) ? (hi - lo) / median : 0;
+
+  converged = (precision <= g_speedPrecision);
+
+  return precision;
+}
+
+//-----------------------------------------------------------------------------
+// Eviction buffer for SPEED_COLD_EVICT. Reading one word per line of a buffer
+// twice the size of the last-level cache pushes everything else out, the
+// hash's code included, which clflush on the key and tables can't do.
+
+volatile uint64_t g_evictSink = 0;
+
+void EvictCaches ( void )
+{
+  static uint64_t * buffer = NULL;
+  static size_t words = 0;
+
+  if(buffer == NULL)
+  {
+    int64_t llc = GetCacheSize(3);
+    if(llc <= 0) llc = GetCacheSize(2);
+    if(llc <= 0) llc = 16 * 1024 * 1024;
+
+    words = size_t(llc * 2) / sizeof(uint64_t);
+    buffer = new uint64_t[words];
+
+    for(size_t i = 0; i < words; i++) buffer[i] = i;
+  }
+
+  uint64_t sum = 0;
+
+  for(size_t i = 0; i < words; i += 64 / sizeof(uint64_t)) sum += buffer[i];
+
+  g_evictSink = sum;
+}
+
+//-----------------------------------------------------------------------------
+// Optional energy readings from the RAPL package counters. The counters only
+// update about once a millisecond, in steps of ~15 microjoules, so rather
+// than wrapping individual calls we hash the same block back to back for
+// g_speedEnergyTime seconds and divide. An idle period of the same length is
+// measured first so the report can separate the hash's own energy from the
+// package's idle draw.
+
+bool g_speedEnergy = false;
+double g_speedEnergyTime = 2.0;
+
+EnergyCounters g_energy;
+
+void EnergySpeedTest ( pfHash hash, uint32_t seed, const int blocksize )
+{
+  printf("Energy - %d-byte keys - ",blocksize);
+
+  ResultsSetTest("Energy","%d-byte keys",blocksize);
+
+  if(!g_energy.open())
+  {
+    printf("n/a (no readable RAPL powercap counters)\n");
+
+    ResultBegin();
+    ResultDouble("nj_per_byte",NAN);
+    ResultEnd();
+    return;
+  }
+
+  double j0, j1, j2;
+
+  double t0 = GetWallTime();
+  g_energy.read(j0);
+
+  SleepMillis(int(g_speedEnergyTime * 1000.0));
+
+  double t1 = GetWallTime();
+  g_energy.read(j1);
+
+  Rand r(seed);
+
+  std::vector<uint8_t> block(blocksize);
+  r.rand_p(&block[0],blocksize);
+
+  uint32_t out[16];
+  double bytes = 0;
+  double t2;
+
+  do
+  {
+    for(int i = 0; i < 16; i++) hash(&block[0],blocksize,seed,out);
+
+    bytes += 16.0 * blocksize;
+    t2 = GetWallTime();
+  }
+  while(t2 - t1 < g_speedEnergyTime);
+
+  g_energy.read(j2);
+
+  double idlewatts = (j1 - j0) / (t1 - t0);
+  double watts = (j2 - j1) / (t2 - t1);
+
+  double nj = (j2 - j1) * 1.0e9 / bytes;
+  double njactive = std::max(0.0,(j2 - j1) - idlewatts * (t2 - t1)) * 1.0e9 / bytes;
+
+  printf("%8.4f nJ/byte - %8.4f above idle - %6.2f W package, %6.2f W idle - %d domain%s\n",
+         nj,njactive,watts,idlewatts,g_energy.domains(),(g_energy.domains() == 1) ? "" : "s");
+
+  ResultBegin();
+  ResultDouble("nj_per_byte",nj);
+  ResultDouble("nj_per_byte_above_idle",njactive);
+  ResultDouble("watts",watts);
+  ResultDouble("idle_watts",idlewatts);
+  ResultEnd();
+}
+
+//-----------------------------------------------------------------------------
+// If 'counts' is non-null and the counters are enabled, it receives the
+// hardware event totals for all trials.
+
+// Returns the median - the statistic the early-exit rule converges on - from
+// 'hist' if it's non-null, which then receives every sample, otherwise from
+// the exact samples.
 
-double SpeedTest ( pfHash hash, uint32_t seed, const int trials, const int blocksize, const int align )
+// Early exit stops as soon as the median is precise enough, which says
+// nothing about the tail, so callers that report high percentiles set
+// stats->mintrials.
+
+double SpeedTest ( pfHash hash, uint32_t seed, const int trials, const int blocksize, const int align, const int flags, PerfCounts * counts, Histogram * hist, SpeedStats * stats )
 {
   Rand r(seed);
   
@@ -183,26 +477,285 @@ double SpeedTest ( pfHash hash, uint32_t seed, const int trials, const int block
   //----------
 
   std::vector<double> times;
-  times.reserve(trials);
+  if(hist == NULL) times.reserve(trials);
+
+  // Only used for its sample count when the caller wants the filtered mean.
 
-  for(int itrial = 0; itrial < trials; itrial++)
+  Histogram local;
+  Histogram & h = hist ? *hist : local;
+
+  HashTable tables[8];
+  int ntables = (flags & SPEED_COLD_TABLES) ? GetHashTables(hash,tables,8) : 0;
+
+  int mintrials = std::max(100,trials / 100);
+
+  if(stats) mintrials = std::max(mintrials,stats->mintrials);
+
+  mintrials = std::min(trials,mintrials);
+
+  int nextcheck = mintrials;
+
+  double begin = GetWallTime();
+
+  bool counting = (counts != NULL) && g_speedCounters && g_counters.open();
+
+  if(counting) g_counters.reset();
+
+  int itrial;
+
+  for(itrial = 0; itrial < trials; itrial++)
   {
     r.rand_p(block,blocksize);
+
+    if(flags & SPEED_COLD_EVICT) EvictCaches();
+
+    if(flags & SPEED_COLD_KEY) FlushCacheLines(block,blocksize);
+
+    for(int i = 0; i < ntables; i++) FlushCacheLines(tables[i].ptr,tables[i].size);
     
+    if(counting) g_counters.start();
+
     double t = (double)timehash(hash,block,blocksize,itrial);
+
+    if(counting) g_counters.stop();
     
-    if(t > 0) times.push_back(t);
+    if(t > 0)
+    {
+      h.record((uint64_t)t);
+      if(hist == NULL) times.push_back(t);
+    }
+
+    if((itrial + 1 == nextcheck) && (h.count() > 0))
+    {
+      bool converged;
+
+      if(hist) MedianPrecision(h,converged);
+      else     MedianPrecision(times,converged);
+
+      if((g_speedPrecision > 0) && converged) { itrial++; break; }
+      if((g_speedTimeLimit > 0) && (GetWallTime() - begin > g_speedTimeLimit)) { itrial++; break; }
+
+      nextcheck += std::max(1,nextcheck / 4);
+    }
+  }
+
+  if(stats)
+  {
+    bool converged;
+
+    stats->trials = itrial;
+
+    if(stats->samples) stats->samples->add(h);
+    if(h.count() == 0) stats->precision = 0;
+    else if(hist)      stats->precision = MedianPrecision(h,converged);
+    else               stats->precision = MedianPrecision(times,converged);
+  }
+
+  if(counts)
+  {
+    if(!counting || !g_counters.read(*counts)) memset(counts,0,sizeof(PerfCounts));
   }
 
   //----------
-  
-  std::sort(times.begin(),times.end());
-  
-  FilterOutliers(times);
-  
+
   delete [] buf;
-  
-  return CalcMean(times);
+
+  if(hist) return hist->percentile(50);
+
+  return CalcMedian(times);
+}
+
+//-----------------------------------------------------------------------------
+// Measurement overhead. Every timed call pays for the timestamp reads, the
+// indirect call and the store of the result, which for 1-8 byte keys can be
+// as much as the hash itself. We measure that once per output width with an
+// empty function that only writes its output, and subtract it from the
+// small-key results.
+
+template < int hashbytes >
+void EmptyHash ( const void *, int, uint32_t, void * out )
+{
+  memset(out,0,hashbytes);
+}
+
+NEVER_INLINE int64_t timeempty ( void )
+{
+  uint64_t begin = timer_start();
+  uint64_t end = timer_end();
+
+  return end-begin;
+}
+
+double GetTimerOverhead ( void )
+{
+  static double overhead = -1;
+
+  if(overhead < 0)
+  {
+    Histogram hist;
+
+    for(int i = 0; i < 200000; i++) hist.record(timeempty());
+
+    overhead = hist.percentile(50);
+  }
+
+  return overhead;
+}
+
+double GetCallOverhead ( int hashsize )
+{
+  static double overhead[4] = { -1, -1, -1, -1 };
+
+  int i = (hashsize <= 4) ? 0 : (hashsize <= 8) ? 1 : (hashsize <= 16) ? 2 : 3;
+
+  if(overhead[i] < 0)
+  {
+    pfHash empty[4] = { EmptyHash<4>, EmptyHash<8>, EmptyHash<16>, EmptyHash<32> };
+
+    Histogram hist;
+
+    overhead[i] = SpeedTest(empty[i],0,199999,0,0,SPEED_WARM,NULL,&hist,NULL);
+  }
+
+  return overhead[i];
+}
+
+//-----------------------------------------------------------------------------
+// Reference kernels, timed through SpeedTest exactly like a hash so they see
+// the same buffers, alignments and sampling. Read-sum is the fastest a hash
+// can possibly consume its input - a hash that gets close to it is at the
+// bandwidth roofline and won't get faster from more SIMD, one well below it
+// is compute-bound. Memcpy and the non-temporal (MOVNTDQA) read are there to
+// show how the host's copy and streaming-load paths compare.
+
+// The copy destination. GetReferenceSpeeds sizes it to the block before
+// timing, so the kernel never has to grow it inside a timed call.
+
+static std::vector<uint8_t> g_copyBuffer;
+
+void MemcpyKernel ( const void * key, int len, uint32_t, void * out )
+{
+  if(g_copyBuffer.size() < (size_t)len + 1) g_copyBuffer.resize(len + 1);
+
+  uint8_t * dst = &g_copyBuffer[0];
+
+  memcpy(dst,key,len);
+
+  *(uint32_t*)out = dst[len/2];
+}
+
+// Four independent accumulators, so the adds never limit the load rate
+
+void ReadSumKernel ( const void * key, int len, uint32_t, void * out )
+{
+  const uint64_t * p = (const uint64_t*)key;
+  const int words = len / 8;
+
+  uint64_t a = 0, b = 0, c = 0, d = 0;
+
+  int i = 0;
+
+  for(; i + 4 <= words; i += 4)
+  {
+    a += p[i+0];
+    b += p[i+1];
+    c += p[i+2];
+    d += p[i+3];
+  }
+
+  for(; i < words; i++) a += p[i];
+
+  *(uint64_t*)out = a + b + c + d;
+}
+
+#ifdef SMHASHER_STREAM_LOAD
+
+// Stream loads need 16-byte alignment, so the head and tail are read normally
+
+__attribute__((target("sse4.1")))
+void StreamReadKernel ( const void * key, int len, uint32_t, void * out )
+{
+  const uint8_t * p = (const uint8_t*)key;
+  const uint8_t * end = p + len;
+
+  uint64_t sum = 0;
+
+  while((p < end) && (uintptr_t(p) & 15)) sum += *p++;
+
+  __m128i a = _mm_setzero_si128();
+  __m128i b = _mm_setzero_si128();
+
+  for(; p + 32 <= end; p += 32)
+  {
+    a = _mm_add_epi64(a,_mm_stream_load_si128((__m128i*)p));
+    b = _mm_add_epi64(b,_mm_stream_load_si128((__m128i*)(p + 16)));
+  }
+
+  while(p < end) sum += *p++;
+
+  a = _mm_add_epi64(a,b);
+
+  *(uint64_t*)out = sum + (uint64_t)_mm_cvtsi128_si64(a) + (uint64_t)_mm_extract_epi64(a,1);
+}
+
+#endif
+
+// Bytes/cycle for each reference kernel at the bulk test's block size and
+// each of its alignments, plus the mean over the alignments. Measured once
+// per block size and cached. Stream read is 0 where it isn't available.
+
+struct ReferenceSpeeds
+{
+  int blocksize;
+
+  double copy[8];
+  double readsum[8];
+  double stream[8];
+
+  double meancopy;
+  double meanreadsum;
+  double meanstream;
+};
+
+const ReferenceSpeeds & GetReferenceSpeeds ( uint32_t seed, int blocksize )
+{
+  static ReferenceSpeeds speeds = { 0 };
+
+  if(speeds.blocksize != blocksize)
+  {
+    const int trials = 2999;
+
+    g_copyBuffer.resize(blocksize + 1);
+
+#ifdef SMHASHER_STREAM_LOAD
+    const bool stream = (GetCPUFeatures() & CPU_SSE41) != 0;
+#endif
+
+    speeds.blocksize = blocksize;
+    speeds.meancopy = 0;
+    speeds.meanreadsum = 0;
+    speeds.meanstream = 0;
+
+    for(int align = 0; align < 8; align++)
+    {
+      speeds.copy[align]    = double(blocksize) / SpeedTest(MemcpyKernel,seed,trials,blocksize,align,SPEED_WARM,NULL,NULL,NULL);
+      speeds.readsum[align] = double(blocksize) / SpeedTest(ReadSumKernel,seed,trials,blocksize,align,SPEED_WARM,NULL,NULL,NULL);
+      speeds.stream[align]  = 0;
+
+#ifdef SMHASHER_STREAM_LOAD
+      if(stream)
+      {
+        speeds.stream[align] = double(blocksize) / SpeedTest(StreamReadKernel,seed,trials,blocksize,align,SPEED_WARM,NULL,NULL,NULL);
+      }
+#endif
+
+      speeds.meancopy    += speeds.copy[align] / 8;
+      speeds.meanreadsum += speeds.readsum[align] / 8;
+      speeds.meanstream  += speeds.stream[align] / 8;
+    }
+  }
+
+  return speeds;
 }
 
 //-----------------------------------------------------------------------------
@@ -215,28 +768,1754 @@ void BulkSpeedTest ( pfHash hash, uint32_t seed )
 
   printf("Bulk speed test - %d-byte keys\n",blocksize);
 
+  PerfCounts total;
+  memset(&total,0,sizeof(total));
+
+  double totaltrials = 0;
+  double totalbpc = 0;
+
+  // Each alignment is compared with the faster of the two plain reads at
+  // the same alignment, which is the host's raw read bandwidth there
+
+  const ReferenceSpeeds & ref = GetReferenceSpeeds(seed,blocksize);
+
+  double totalratio = 0;
+
   for(int align = 0; align < 8; align++)
   {
-    double cycles = SpeedTest(hash,seed,trials,blocksize,align);
+    PerfCounts counts;
+    Histogram samples;
+    SpeedStats stats;
+    stats.mintrials = 0;
+    stats.samples = &samples;
+
+    ResultsSetTest("Bulk","%d-byte keys, alignment %d",blocksize,align);
+
+    double cycles = SpeedTest(hash,seed,trials,blocksize,align,SPEED_WARM,&counts,NULL,&stats);
+
+    BaselineRecord("bulk",align,samples);
+
+    totaltrials += stats.trials;
+
+    for(int i = 0; i < PERFCTR_COUNT; i++)
+    {
+      total.value[i] += counts.value[i];
+      total.valid[i] = counts.valid[i];
+    }
     
     double bestbpc = double(blocksize)/cycles;
-    
-    double bestbps = (bestbpc * 3000000000.0 / 1048576.0);
-    printf("Alignment %2d - %6.3f bytes/cycle - %7.2f MiB/sec @ 3 ghz\n",align,bestbpc,bestbps);
-  }
-}
 
-//-----------------------------------------------------------------------------
+    totalbpc += bestbpc;
 
-void TinySpeedTest ( pfHash hash, int hashsize, int keysize, uint32_t seed, bool verbose, double & /*outCycles*/ )
-{
-  const int trials = 999999;
+    double ratio = bestbpc / std::max(ref.readsum[align],ref.stream[align]);
 
-  if(verbose) printf("Small key speed test - %4d-byte keys - ",keysize);
-  
-  double cycles = SpeedTest(hash,seed,trials,keysize,0);
+    totalratio += ratio;
+
+    double nanos = CyclesToNanos(cycles);
+    
+    double bestbps = (double(blocksize) * 1.0e9 / nanos) / 1048576.0;
+    printf("Alignment %2d - %6.3f bytes/cycle - %8.2f MiB/sec - %9.0f ns/hash - +/-%5.2f%% (%d trials)\n",
+           align,bestbpc,bestbps,nanos,stats.precision * 50.0,stats.trials);
+
+    ResultBegin();
+    ResultDouble("cycles",cycles);
+    ResultDouble("bytes_per_cycle",bestbpc);
+    ResultDouble("ns",nanos);
+    ResultDouble("precision",stats.precision);
+    ResultInt("trials",stats.trials);
+    ResultDouble("read_bandwidth_ratio",ratio);
+    ResultEnd();
+  }
+
+  if(g_speedCounters)
+  {
+    printf("Counters");
+    PrintCounters(total,totaltrials,totaltrials * blocksize);
+    printf("\n");
+  }
+
+  // A hash can't read its input faster than a plain read does, so a ratio
+  // above 100% means it isn't reading all of it (or the measurement is off)
+  // and there's no roofline to place it on.
+
+  double pct = 100.0 * totalratio / 8;
+
+  const char * bound = (pct > 100.0) ? "n/a" : (pct >= 80.0) ? "bandwidth" : "compute";
+
+  printf("Reference    - memcpy %6.3f, read-sum %6.3f, non-temporal read ",ref.meancopy,ref.meanreadsum);
+  if(ref.meanstream > 0) printf("%6.3f",ref.meanstream);
+  else                   printf("   n/a");
+  printf(" bytes/cycle, alignments 0-7 - ");
+
+  if(pct > 100.0) printf("hash exceeds the read bandwidth (%.1f%%), no roofline comparison\n",pct);
+  else            printf("hash at %5.1f%% of read bandwidth (%s)\n",pct,(pct >= 80.0) ? "at the bandwidth roofline" : "compute-bound");
+
+  ResultsSetTest("Bulk","%d-byte keys, reference kernels",blocksize);
+  ResultBegin();
+  ResultDouble("memcpy_bytes_per_cycle",ref.meancopy);
+  ResultDouble("readsum_bytes_per_cycle",ref.meanreadsum);
+  ResultDouble("stream_bytes_per_cycle",(ref.meanstream > 0) ? ref.meanstream : NAN);
+  ResultDouble("hash_bytes_per_cycle",totalbpc / 8);
+  ResultDouble("pct_of_read_bandwidth",pct);
+  ResultString("bound",bound);
+  ResultEnd();
+
+  if(g_speedEnergy) EnergySpeedTest(hash,seed,blocksize);
+}
+
+//-----------------------------------------------------------------------------
+
+// Small keys are where the tail matters - a hash that's usually fast but
+// occasionally takes a slow path shows up in the upper percentiles, which is
+// exactly what outlier filtering would throw away. So we keep a histogram of
+// every sample and report the median along with the tail.
+
+// The median is reported both raw and with the call overhead subtracted, the
+// percentiles are raw. A percentile with fewer than 10 samples above it -
+// when the time limit cut the run short - is too noisy to mean anything and
+// comes out as nan (null in the results file), and so does the max with it.
+
+double TailPercentile ( const Histogram & hist, double p )
+{
+  double above = double(hist.count()) * (100.0 - p) / 100.0;
+
+  return (above >= 10.0) ? hist.percentile(p) : NAN;
+}
+
+void TinySpeedTest ( pfHash hash, int hashsize, int keysize, uint32_t seed, bool verbose, double & outCycles )
+{
+  const int trials = 999999;
+
+  // Enough samples that ~100 of them lie above the 99.9th percentile
+
+  const int tailtrials = 100000;
+
+  if(verbose) printf("Small key speed test - %4d-byte keys - ",keysize);
+  
+  PerfCounts counts;
+  Histogram hist;
+  SpeedStats stats;
+  stats.mintrials = tailtrials;
+  stats.samples = NULL;
+
+  ResultsSetTest("Tiny","%d-byte keys",keysize);
+
+  double raw = SpeedTest(hash,seed,trials,keysize,0,SPEED_WARM,&counts,&hist,&stats);
+
+  BaselineRecord("tiny",keysize,hist);
+
+  double cycles = std::max(0.0,raw - GetCallOverhead(hashsize));
   
-  printf("%8.2f cycles/hash\n",cycles);  
+  printf("%8.2f cycles/hash raw - %8.2f corrected - %8.2f ns/hash - +/-%5.2f%% (%7d trials)",
+         raw,cycles,CyclesToNanos(cycles),stats.precision * 50.0,stats.trials);
+  double p90  = TailPercentile(hist,90);
+  double p99  = TailPercentile(hist,99);
+  double p999 = TailPercentile(hist,99.9);
+  double peak = isnan(p999) ? NAN : double(hist.max());
+
+  printf(" - p90 %7.1f - p99 %7.1f - p99.9 %8.1f - max %9.0f",p90,p99,p999,peak);
+  if(g_speedCounters) PrintCounters(counts,stats.trials,double(stats.trials) * keysize);
+  printf("\n");
+
+  ResultBegin();
+  ResultDouble("cycles_raw",raw);
+  ResultDouble("cycles",cycles);
+  ResultDouble("ns",CyclesToNanos(cycles));
+  ResultDouble("precision",stats.precision);
+  ResultInt("trials",stats.trials);
+  ResultDouble("p90",p90);
+  ResultDouble("p99",p99);
+  ResultDouble("p99_9",p999);
+  ResultDouble("max",peak);
+  ResultEnd();
+
+  outCycles = cycles;
+}
+
+//-----------------------------------------------------------------------------
+// Cold-cache latency. TinySpeedTest re-randomizes the key right before each
+// call, so the key, the hash's code and any lookup tables are always in L1.
+// A lookup that misses in the cache sees none of that, so for a range of key
+// sizes we time the same call with the key flushed, with the key and the
+// hash's tables flushed, and after evicting everything.
+
+void ColdSpeedTest ( pfHash hash, int hashsize, uint32_t seed )
+{
+  const int sizes[] = { 1, 4, 16, 64, 256, 1024, 4096 };
+  const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  HashTable tables[8];
+  int ntables = GetHashTables(hash,tables,8);
+
+  size_t tablebytes = 0;
+  for(int i = 0; i < ntables; i++) tablebytes += tables[i].size;
+
+  double overhead = GetCallOverhead(hashsize);
+
+  printf("Cold cache test - %d lookup table(s), %d bytes\n",ntables,(int)tablebytes);
+  printf("Keysize | warm ns/hash | cold key ns/hash | cold key+tables ns/hash | evicted ns/hash\n");
+
+  const int modes[4] = { SPEED_WARM, SPEED_COLD_KEY, SPEED_COLD_KEY | SPEED_COLD_TABLES, SPEED_COLD_EVICT };
+
+  for(int i = 0; i < nsizes; i++)
+  {
+    ResultsSetTest("Cold","%d-byte keys",sizes[i]);
+
+    double ns[4];
+
+    for(int m = 0; m < 4; m++)
+    {
+      // Without registered tables this mode would just repeat the cold key one
+
+      if((modes[m] & SPEED_COLD_TABLES) && (ntables == 0)) { ns[m] = NAN; continue; }
+
+      Histogram hist;
+
+      // Sweeping the eviction buffer dominates the run time, so it gets far
+      // fewer trials.
+
+      int trials = (modes[m] & SPEED_COLD_EVICT) ? 299 : 29999;
+
+      double cycles = SpeedTest(hash,seed,trials,sizes[i],0,modes[m],NULL,&hist,NULL);
+
+      ns[m] = CyclesToNanos(std::max(0.0,cycles - overhead));
+    }
+
+    printf("%7d | %12.2f | %16.2f | ",sizes[i],ns[0],ns[1]);
+    if(ntables > 0) printf("%23.2f",ns[2]);
+    else            printf("%23s","n/a (no tables)");
+    printf(" | %15.2f\n",ns[3]);
+
+    ResultBegin();
+    ResultDouble("warm_ns",ns[0]);
+    ResultDouble("cold_key_ns",ns[1]);
+    ResultDouble("cold_tables_ns",ns[2]);
+    ResultDouble("evicted_ns",ns[3]);
+    ResultEnd();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Small-key latency vs. throughput. TinySpeedTest times a single isolated
+// call, which is neither what a chain of dependent lookups sees (latency) nor
+// what a batch of independent lookups sees (throughput) - out-of-order cores
+// overlap consecutive independent hashes, so the gap between the two tells us
+// how much of a hash's speed comes from instruction-level parallelism.
+
+// Latency - every call's output is folded into the next call's key and seed,
+// so no call can start before the previous one finishes.
+
+NEVER_INLINE int64_t timechain ( pfHash hash, uint8_t * key, int len, int count, uint32_t seed )
+{
+  uint32_t temp[16];
+
+  memset(temp,0,sizeof(temp));
+
+  uint64_t begin = timer_start();
+
+  for(int i = 0; i < count; i++)
+  {
+    hash(key,len,seed,temp);
+
+    seed = temp[0];
+    if(len) key[0] ^= (uint8_t)seed;
+  }
+
+  uint64_t end = timer_end();
+
+  blackhole(seed);
+
+  return end-begin;
+}
+
+// Throughput - independent prebuilt keys, independent output slots.
+
+NEVER_INLINE int64_t timestream ( pfHash hash, const uint8_t * keys, int stride, int len, int count, uint32_t seed, uint32_t * out, int outwords )
+{
+  uint64_t begin = timer_start();
+
+  for(int i = 0; i < count; i++)
+  {
+    hash(keys + i*stride,len,seed,out + i*outwords);
+  }
+
+  uint64_t end = timer_end();
+
+  return end-begin;
+}
+
+void LatencyThroughputTest ( pfHash hash, int hashsize, uint32_t seed )
+{
+  const int reps = 99;
+  const int chainlen = 1000;
+  const int keycount = 2048;
+  const int maxlen = 256;
+
+  const int stride = (maxlen + 7) & ~7;
+  const int outwords = (hashsize + 3) / 4;
+
+  printf("Small key latency/throughput test - dependent chain vs. %d independent keys\n",keycount);
+  printf("Keylen | latency cycles/hash | throughput cycles/hash | overlap\n");
+
+  Rand r(seed);
+
+  std::vector<uint8_t> keys(keycount * stride);
+  std::vector<uint32_t> out(keycount * outwords);
+
+  r.rand_p(&keys[0],(int)keys.size());
+
+  std::vector<double> latency;
+  std::vector<double> throughput;
+
+  for(int len = 0; len <= maxlen; len += (len < 32) ? 1 : 8)
+  {
+    ResultsSetTest("LatencyThroughput","%d-byte keys",len);
+
+    latency.clear();
+    throughput.clear();
+
+    for(int rep = 0; rep < reps; rep++)
+    {
+      latency.push_back(double(timechain(hash,&keys[0],len,chainlen,seed)) / chainlen);
+      throughput.push_back(double(timestream(hash,&keys[0],stride,len,keycount,seed,&out[0],outwords)) / keycount);
+    }
+
+    double lat = CalcMedian(latency);
+    double thr = CalcMedian(throughput);
+
+    printf("%6d | %19.2f | %22.2f | %6.2fx\n",len,lat,thr,lat / thr);
+
+    ResultBegin();
+    ResultDouble("latency_cycles",lat);
+    ResultDouble("throughput_cycles",thr);
+    ResultEnd();
+  }
+}
+
+//----------
+
+void PrintInlinedRow ( int len, std::vector<double> & indirect, std::vector<double> & inlined )
+{
+  double a = CalcMedian(indirect);
+  double b = CalcMedian(inlined);
+
+  printf("%6d | %20.2f | %19.2f | %6.2fx\n",len,a,b,a / b);
+
+  ResultBegin();
+  ResultDouble("indirect_cycles",a);
+  ResultDouble("inlined_cycles",b);
+  ResultDouble("speedup",a / b);
+  ResultEnd();
+}
+
+//-----------------------------------------------------------------------------
+// Small-key alignment. Keys pulled out of packed buffers start at arbitrary
+// offsets, so we time every key length from 1 to 64 bytes at every offset
+// within a cache line. The line sits at the end of a 4 KiB page, so a key
+// that runs off the end of its line also crosses into the next page - we
+// time those keys a second time in the middle of a page to separate the
+// cache-line split penalty from the page split penalty.
+
+void TimeKeyAt ( pfHash hash, uint8_t * key, int len, uint32_t seed, Rand & r, int trials, Histogram & hist )
+{
+  for(int i = 0; i < trials; i++)
+  {
+    r.rand_p(key,len);
+
+    int64_t t = timehash(hash,key,len,seed + i);
+
+    if(t > 0) hist.record((uint64_t)t);
+  }
+}
+
+void AlignmentSpeedTest ( pfHash hash, uint32_t seed )
+{
+  const int line = 64;
+  const int page = 4096;
+  const int maxlen = 64;
+  const int rounds = 8;
+  const int trials = 250;
+
+  Rand r(seed);
+
+  // Three pages, so the one we use is followed by another and the key's
+  // bytes past the page boundary are mapped.
+
+  std::vector<uint8_t> buf(page * 3);
+
+  uint64_t base = reinterpret_cast<uint64_t>(&buf[0]);
+  base = (base + page - 1) & ~uint64_t(page - 1);
+
+  uint8_t * pageend = reinterpret_cast<uint8_t*>(base) + page - line;
+  uint8_t * midpage = reinterpret_cast<uint8_t*>(base) + page / 2;
+
+  // cycles[len][offset] with the line at the end of a page, and for keys
+  // that cross their line, the same in the middle of a page.
+
+  std::vector< std::vector<double> > pagecycles(maxlen + 1,std::vector<double>(line,0));
+  std::vector< std::vector<double> > linecycles(maxlen + 1,std::vector<double>(line,0));
+
+  // The offsets for each length are timed round-robin in short bursts, so
+  // slow drift in the machine's speed hits all of them equally instead of
+  // showing up as a penalty.
+
+  std::vector<Histogram> pagehist(line);
+  std::vector<Histogram> linehist(line);
+
+  ResultsSetTest("Alignment","1-%d byte keys, offsets 0-%d",maxlen,line - 1);
+
+  for(int len = 1; len <= maxlen; len++)
+  {
+    for(int offset = 0; offset < line; offset++)
+    {
+      pagehist[offset].clear();
+      linehist[offset].clear();
+    }
+
+    for(int round = 0; round < rounds; round++)
+    {
+      for(int offset = 0; offset < line; offset++)
+      {
+        TimeKeyAt(hash,pageend + offset,len,seed,r,trials,pagehist[offset]);
+
+        if(offset + len > line)
+        {
+          TimeKeyAt(hash,midpage + offset,len,seed,r,trials,linehist[offset]);
+        }
+      }
+    }
+
+    for(int offset = 0; offset < line; offset++)
+    {
+      pagecycles[len][offset] = pagehist[offset].percentile(50);
+
+      if(offset + len > line) linecycles[len][offset] = linehist[offset].percentile(50);
+    }
+  }
+
+  //----------
+
+  printf("Small key alignment test - 1-%d byte keys at offsets 0-%d within a cache line\n",maxlen,line - 1);
+  printf("Penalties are cycles/hash relative to offset 0 of the same key length\n");
+  printf("Keylen | offset 0 | in-line worst (off) | line-split avg worst (off) | page-split avg worst (off)\n");
+
+  for(int len = 1; len <= maxlen; len++)
+  {
+    double base0 = pagecycles[len][0];
+
+    double inworst = 0, linesum = 0, lineworst = 0, pagesum = 0, pageworst = 0;
+    int inoff = 0, lineoff = 0, pageoff = 0, splits = 0;
+
+    for(int offset = 1; offset < line; offset++)
+    {
+      if(offset + len <= line)
+      {
+        double d = pagecycles[len][offset] - base0;
+        if(d > inworst) { inworst = d; inoff = offset; }
+        continue;
+      }
+
+      double dl = linecycles[len][offset] - base0;
+      double dp = pagecycles[len][offset] - base0;
+
+      linesum += dl;
+      pagesum += dp;
+      splits++;
+
+      if(dl > lineworst) { lineworst = dl; lineoff = offset; }
+      if(dp > pageworst) { pageworst = dp; pageoff = offset; }
+    }
+
+    printf("%6d | %8.1f | %12.1f (%2d) |",len,base0,inworst,inoff);
+
+    ResultBegin();
+    ResultInt("keylen",len);
+    ResultDouble("offset0_cycles",base0);
+    ResultDouble("inline_worst_penalty",inworst);
+    ResultInt("inline_worst_offset",inoff);
+
+    if(splits)
+    {
+      printf(" %8.1f %9.1f (%2d) | %8.1f %9.1f (%2d)\n",
+             linesum / splits,lineworst,lineoff,pagesum / splits,pageworst,pageoff);
+
+      ResultDouble("line_split_avg_penalty",linesum / splits);
+      ResultDouble("line_split_worst_penalty",lineworst);
+      ResultInt("line_split_worst_offset",lineoff);
+      ResultDouble("page_split_avg_penalty",pagesum / splits);
+      ResultDouble("page_split_worst_penalty",pageworst);
+      ResultInt("page_split_worst_offset",pageoff);
+    }
+    else
+    {
+      printf("        -                -  |        -                -\n");
+    }
+
+    ResultEnd();
+  }
+
+  // The full matrix, line at the end of a page. Cells right of the diagonal
+  // ('|' marks where the key starts crossing) straddle the page boundary.
+
+  printf("\nPenalty matrix - rows are key lengths, columns offsets, cycles/hash vs. offset 0\n");
+  printf("Keylen |");
+  for(int offset = 0; offset < line; offset++) printf("%4d",offset);
+  printf("\n");
+
+  for(int len = 1; len <= maxlen; len++)
+  {
+    printf("%6d |",len);
+
+    for(int offset = 0; offset < line; offset++)
+    {
+      double d = pagecycles[len][offset] - pagecycles[len][0];
+
+      printf("%c%3.0f",(offset + len == line + 1) ? '|' : ' ',d);
+    }
+
+    printf("\n");
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Variable-length keys. Every other test hashes one length at a time, which
+// lets the branch predictor learn a hash's tail-handling switch perfectly.
+// Here we draw key lengths from a distribution, pack the keys into a pool
+// and hash the pool twice - once in the order drawn, and once with the same
+// keys sorted by length. The work is identical, so the difference between
+// the two is what length dispatch costs when lengths are unpredictable.
+
+const char * g_lengthFile = NULL;
+
+// Lengths from an empirical histogram file - one "length count" pair per
+// line, '#' starts a comment. 'weights' is indexed by length.
+
+bool LoadLengthHistogram ( const char * filename, std::vector<double> & weights )
+{
+  FILE * f = fopen(filename,"r");
+
+  if(f == NULL)
+  {
+    printf("Can't open key length histogram '%s'\n",filename);
+    return false;
+  }
+
+  weights.clear();
+
+  char line[256];
+  int lineno = 0;
+
+  while(fgets(line,sizeof(line),f))
+  {
+    lineno++;
+
+    char * comment = strchr(line,'#');
+    if(comment) *comment = 0;
+
+    int len;
+    double count;
+
+    // sscanf only returns EOF for blank (or comment-only) lines - anything
+    // else that doesn't parse is an error, not something to skip
+
+    int fields = sscanf(line,"%d %lf",&len,&count);
+
+    if(fields == EOF) continue;
+
+    if((fields != 2) || (len < 0) || (len > (1 << 24)) || !(count >= 0))
+    {
+      printf("%s:%d - expected 'length count'\n",filename,lineno);
+      fclose(f);
+      return false;
+    }
+
+    if((int)weights.size() <= len) weights.resize(len + 1,0);
+
+    weights[len] += count;
+  }
+
+  fclose(f);
+
+  double total = 0;
+
+  for(size_t i = 0; i < weights.size(); i++) total += weights[i];
+
+  if(!(total > 0))
+  {
+    printf("Key length histogram '%s' is empty\n",filename);
+    return false;
+  }
+
+  return true;
+}
+
+// Draw 'count' lengths with probability proportional to weights[length]
+
+void DrawLengths ( const std::vector<double> & weights, int count, Rand & r, std::vector<int> & lengths )
+{
+  std::vector<double> cdf(weights.size());
+
+  double sum = 0;
+
+  for(size_t i = 0; i < weights.size(); i++)
+  {
+    sum += weights[i];
+    cdf[i] = sum;
+  }
+
+  lengths.resize(count);
+
+  for(int i = 0; i < count; i++)
+  {
+    double u = (double(r.rand_u32()) + 0.5) / 4294967296.0 * sum;
+
+    lengths[i] = int(std::lower_bound(cdf.begin(),cdf.end(),u) - cdf.begin());
+  }
+}
+
+NEVER_INLINE int64_t timepool ( pfHash hash, const uint8_t * pool, const size_t * offsets, const int * lengths, int count, uint32_t seed, uint32_t * out, int outwords )
+{
+  uint64_t begin = timer_start();
+
+  for(int i = 0; i < count; i++)
+  {
+    hash(pool + offsets[i],lengths[i],seed,out + i*outwords);
+  }
+
+  uint64_t end = timer_end();
+
+  return end-begin;
+}
+
+// Bytes of pool needed to lay out 'lengths' back to back, 8-byte aligned
+
+size_t KeyPoolSize ( const std::vector<int> & lengths )
+{
+  size_t total = 0;
+
+  for(size_t i = 0; i < lengths.size(); i++) total += ((size_t)lengths[i] + 7) & ~size_t(7);
+
+  return total;
+}
+
+// Time one pool of keys laid out back to back in the given order, 8-byte
+// aligned so alignment doesn't get mixed into the result.
+
+double TimeKeyPool ( pfHash hash, int hashsize, uint32_t seed, const std::vector<int> & lengths, double & brmisses )
+{
+  const int reps = 99;
+  const int count = (int)lengths.size();
+  const int outwords = (hashsize + 3) / 4;
+
+  std::vector<size_t> offsets(count);
+
+  size_t total = 0;
+
+  for(int i = 0; i < count; i++)
+  {
+    offsets[i] = total;
+    total += ((size_t)lengths[i] + 7) & ~size_t(7);
+  }
+
+  Rand r(seed);
+
+  std::vector<uint8_t> pool(total + 8);
+  std::vector<uint32_t> out(count * outwords);
+
+  for(size_t pos = 0; pos < pool.size(); pos += (1 << 30))
+  {
+    r.rand_p(&pool[pos],(int)std::min(pool.size() - pos,size_t(1) << 30));
+  }
+
+  std::vector<double> times;
+
+  bool counting = g_speedCounters && g_counters.open();
+
+  if(counting) g_counters.reset();
+
+  for(int rep = 0; rep < reps; rep++)
+  {
+    if(counting) g_counters.start();
+
+    times.push_back(double(timepool(hash,&pool[0],&offsets[0],&lengths[0],count,seed,&out[0],outwords)) / count);
+
+    if(counting) g_counters.stop();
+  }
+
+  PerfCounts counts;
+
+  brmisses = -1;
+
+  if(counting && g_counters.read(counts) && counts.valid[PERFCTR_BRANCH_MISSES])
+  {
+    brmisses = counts.value[PERFCTR_BRANCH_MISSES] / (double(reps) * count);
+  }
+
+  return CalcMedian(times);
+}
+
+void VariableLengthSpeedTest ( pfHash hash, int hashsize, uint32_t seed )
+{
+  const int keycount = 4096;
+  const int maxlen = 64;
+
+  // A length histogram can have keys up to 16 MiB - pools that would need
+  // more memory than this are skipped
+
+  const size_t maxpool = size_t(1) << 30;
+
+  std::vector<const char *> names;
+  std::vector< std::vector<double> > dists;
+
+  std::vector<double> w(maxlen + 1,0);
+
+  // Uniform over 1-64 bytes
+
+  for(int i = 1; i <= maxlen; i++) w[i] = 1;
+
+  names.push_back("uniform 1-64");
+  dists.push_back(w);
+
+  // Zipf with s = 1 - short keys dominate, with a long tail
+
+  for(int i = 1; i <= maxlen; i++) w[i] = 1.0 / i;
+
+  names.push_back("zipf 1-64");
+  dists.push_back(w);
+
+  // Bimodal - 3/4 short identifiers around 8 bytes, 1/4 long ones around 48
+
+  for(int i = 0; i <= maxlen; i++)
+  {
+    w[i] = 0;
+    if((i >= 4) && (i <= 12)) w[i] = 3.0 / 9.0;
+    if((i >= 40) && (i <= 56)) w[i] = 1.0 / 17.0;
+  }
+
+  names.push_back("bimodal 8/48");
+  dists.push_back(w);
+
+  if(g_lengthFile)
+  {
+    if(LoadLengthHistogram(g_lengthFile,w))
+    {
+      names.push_back(g_lengthFile);
+      dists.push_back(w);
+    }
+  }
+
+  printf("Variable-length key test - %d keys per pool, hashed in drawn order and sorted by length\n",keycount);
+  printf("Distribution     | mean len | drawn cycles/hash  MiB/sec  br-miss/hash | sorted cycles/hash  br-miss/hash | dispatch cycles\n");
+
+  Rand r(seed);
+
+  for(size_t d = 0; d < dists.size(); d++)
+  {
+    std::vector<int> lengths;
+
+    ResultsSetTest("VariableLength","%s",names[d]);
+
+    DrawLengths(dists[d],keycount,r,lengths);
+
+    size_t poolsize = KeyPoolSize(lengths);
+
+    if(poolsize > maxpool)
+    {
+      printf("%-16.16s | skipped - a %d-key pool needs %.0f MiB, more than the %d MiB limit\n",
+             names[d],keycount,double(poolsize) / 1048576.0,(int)(maxpool >> 20));
+      continue;
+    }
+
+    double meanlen = 0;
+    for(int i = 0; i < keycount; i++) meanlen += lengths[i];
+    meanlen /= keycount;
+
+    double drawnmiss, sortedmiss;
+
+    double drawn = TimeKeyPool(hash,hashsize,seed,lengths,drawnmiss);
+
+    std::sort(lengths.begin(),lengths.end());
+
+    double sorted = TimeKeyPool(hash,hashsize,seed,lengths,sortedmiss);
+
+    double rate = (meanlen * 1.0e9 / CyclesToNanos(drawn)) / 1048576.0;
+
+    printf("%-16.16s | %8.1f | %17.2f %8.2f ",names[d],meanlen,drawn,rate);
+
+    if(drawnmiss >= 0) printf("%13.3f",drawnmiss); else printf("%13s","n/a");
+
+    printf(" | %18.2f ",sorted);
+
+    if(sortedmiss >= 0) printf("%13.3f",sortedmiss); else printf("%13s","n/a");
+
+    printf(" | %15.2f\n",drawn - sorted);
+
+    ResultBegin();
+    ResultDouble("mean_len",meanlen);
+    ResultDouble("drawn_cycles",drawn);
+    ResultDouble("drawn_mib_per_sec",rate);
+    ResultDouble("sorted_cycles",sorted);
+    ResultDouble("dispatch_cycles",drawn - sorted);
+    if(drawnmiss >= 0) ResultDouble("drawn_branch_misses",drawnmiss);
+    if(sortedmiss >= 0) ResultDouble("sorted_branch_misses",sortedmiss);
+    ResultEnd();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// SpookyHash streaming. Init/Update/Final buffers partial blocks in m_data,
+// so small chunks pay for a copy and a call per chunk on top of the hash
+// itself. We feed the same message through it in chunks from 1 byte to
+// 1 MiB, compare the throughput with one-shot Hash128, and check that every
+// chunking produces the one-shot digest. The message isn't a multiple of the
+// block size, so the final partial block is exercised too.
+
+NEVER_INLINE int64_t timespooky ( const uint8_t * msg, size_t len, size_t chunk, uint32_t seed, uint64_t & h1, uint64_t & h2 )
+{
+  SpookyHash state;
+
+  uint64_t begin = timer_start();
+
+  state.Init(seed,seed);
+
+  for(size_t pos = 0; pos < len; pos += chunk)
+  {
+    state.Update(msg + pos,std::min(chunk,len - pos));
+  }
+
+  state.Final(&h1,&h2);
+
+  uint64_t end = timer_end();
+
+  return end-begin;
+}
+
+NEVER_INLINE int64_t timespookyoneshot ( const uint8_t * msg, size_t len, uint32_t seed, uint64_t & h1, uint64_t & h2 )
+{
+  h1 = seed;
+  h2 = seed;
+
+  uint64_t begin = timer_start();
+
+  SpookyHash::Hash128(msg,len,&h1,&h2);
+
+  uint64_t end = timer_end();
+
+  return end-begin;
+}
+
+// Repeat a measurement for at least ~50 ms or 3 runs, return the median
+
+template < class timer >
+double MedianCycles ( timer & t, double budget )
+{
+  std::vector<double> times;
+
+  double begin = GetWallTime();
+
+  while((times.size() < 3) || ((times.size() < 99) && (GetWallTime() - begin < budget)))
+  {
+    times.push_back((double)t());
+  }
+
+  std::sort(times.begin(),times.end());
+
+  return times[times.size() / 2];
+}
+
+struct SpookyStreamTimer
+{
+  const uint8_t * msg;
+  size_t len;
+  size_t chunk;
+  uint32_t seed;
+  uint64_t h1, h2;
+
+  int64_t operator () ( void ) { return timespooky(msg,len,chunk,seed,h1,h2); }
+};
+
+struct SpookyOneShotTimer
+{
+  const uint8_t * msg;
+  size_t len;
+  uint32_t seed;
+  uint64_t h1, h2;
+
+  int64_t operator () ( void ) { return timespookyoneshot(msg,len,seed,h1,h2); }
+};
+
+bool SpookyStreamingTest ( uint32_t seed )
+{
+  const size_t len = (1 << 20) + 13;
+
+  Rand r(seed);
+
+  std::vector<uint8_t> msg(len);
+
+  r.rand_p(&msg[0],(int)len);
+
+  // Powers of two, plus sizes either side of Spooky's 96-byte block and
+  // 192-byte buffer
+
+  std::vector<size_t> chunks;
+
+  for(size_t c = 1; c <= (1 << 20); c *= 2) chunks.push_back(c);
+
+  const size_t extra[] = { 3, 95, 96, 97, 191, 192, 193 };
+
+  for(size_t i = 0; i < sizeof(extra) / sizeof(extra[0]); i++) chunks.push_back(extra[i]);
+
+  std::sort(chunks.begin(),chunks.end());
+
+  ResultsSetTest("SpookyStreaming","one-shot, %d-byte message",(int)len);
+
+  SpookyOneShotTimer oneshot = { &msg[0], len, seed, 0, 0 };
+
+  double base = MedianCycles(oneshot,0.05);
+
+  double baserate = (double(len) * 1.0e9 / CyclesToNanos(base)) / 1048576.0;
+
+  printf("SpookyHash streaming test - %d-byte message, Init/Update/Final vs. one-shot Hash128\n",(int)len);
+  printf("One-shot   | %10.2f MiB/sec\n",baserate);
+
+  ResultBegin();
+  ResultDouble("mib_per_sec",baserate);
+  ResultEnd();
+  printf("Chunk size |    MiB/sec | vs. one-shot | digest\n");
+
+  bool result = true;
+
+  for(size_t i = 0; i < chunks.size(); i++)
+  {
+    ResultsSetTest("SpookyStreaming","%d-byte chunks, %d-byte message",(int)chunks[i],(int)len);
+
+    SpookyStreamTimer stream = { &msg[0], len, chunks[i], seed, 0, 0 };
+
+    double cycles = MedianCycles(stream,0.05);
+
+    bool match = (stream.h1 == oneshot.h1) && (stream.h2 == oneshot.h2);
+
+    double rate = (double(len) * 1.0e9 / CyclesToNanos(cycles)) / 1048576.0;
+
+    printf("%10d | %10.2f | %11.1f%% | %s\n",(int)chunks[i],rate,rate / baserate * 100.0,match ? "ok" : "MISMATCH");
+
+    ResultBegin();
+    ResultDouble("mib_per_sec",rate);
+    ResultDouble("vs_oneshot",rate / baserate);
+    ResultBool("match",match);
+    ResultEnd();
+
+    result &= match;
+  }
+
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// Bulk throughput of a hash against a reference hash from the same family,
+// over key lengths around and beyond the point where they diverge - e.g.
+// CityHashCrc128 falls back to CityHash128 up to 900 bytes and only takes
+// its CRC path above that.
+
+void BulkCompareTest ( pfHash hash, pfHash reference, const char * refname, uint32_t seed )
+{
+  const int sizes[] = { 64, 256, 900, 1024, 4096, 65536, 262144 };
+  const int nsizes = sizeof(sizes) / sizeof(int);
+
+  const int trials = 2999;
+
+  printf("Bulk comparison against %s\n",refname);
+  printf("Keylen | bytes/cycle | %s bytes/cycle | speedup\n",refname);
+
+  for(int i = 0; i < nsizes; i++)
+  {
+    const int len = sizes[i];
+
+    ResultsSetTest("BulkCompare","%d-byte keys against %s",len,refname);
+
+    Histogram h1, h2;
+
+    double c1 = SpeedTest(hash,seed,trials,len,0,SPEED_WARM,NULL,&h1,NULL);
+    double c2 = SpeedTest(reference,seed,trials,len,0,SPEED_WARM,NULL,&h2,NULL);
+
+    double bpc1 = double(len) / c1;
+    double bpc2 = double(len) / c2;
+
+    printf("%6d | %11.3f | %*.3f | %6.2fx\n",len,bpc1,(int)strlen(refname) + 12,bpc2,bpc1 / bpc2);
+
+    ResultBegin();
+    ResultDouble("bytes_per_cycle",bpc1);
+    ResultDouble("reference_bytes_per_cycle",bpc2);
+    ResultDouble("speedup",bpc1 / bpc2);
+    ResultEnd();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Multi-buffer MurmurHash3_x86_32 against the scalar one, over a pool of
+// small keys scattered at random offsets in memory - the SIMD versions have
+// to gather every block from a different place, as they would when hashing
+// e.g. a batch of hash table lookups.
+
+struct BatchTimer
+{
+  pfBatchHash hash;
+  const void * const * keys;
+  const int * lens;
+  int count;
+  uint32_t seed;
+  uint32_t * out;
+
+  int64_t operator () ( void )
+  {
+    uint64_t begin = timer_start();
+
+    hash(keys,lens,count,seed,out);
+
+    uint64_t end = timer_end();
+
+    return end-begin;
+  }
+};
+
+// Batch sizes that leave every possible remainder path - under a full
+// group, one short of or one past a group of 8 or 16, and a large odd batch
+// - with lengths from 0 to well past the timed ones, against the scalar
+// hash. Returns the number of keys that hashed differently.
+
+int BatchCheck ( pfBatchHash hash, uint32_t seed )
+{
+  const int counts[] = { 1, 7, 8, 9, 15, 16, 17, 31, 33, 4095 };
+  const int ncounts = sizeof(counts) / sizeof(int);
+
+  const int maxlen = 300;
+  const int maxcount = 4095;
+
+  Rand r(seed);
+
+  std::vector<uint8_t> pool(maxcount * (maxlen + 16));
+  std::vector<const void*> keys(maxcount);
+  std::vector<int> lens(maxcount);
+  std::vector<uint32_t> ref(maxcount);
+  std::vector<uint32_t> out(maxcount);
+
+  r.rand_p(&pool[0],(int)pool.size());
+
+  int mismatches = 0;
+
+  for(int c = 0; c < ncounts; c++)
+  {
+    const int count = counts[c];
+
+    // One key in eight is empty
+
+    for(int i = 0; i < count; i++)
+    {
+      keys[i] = &pool[i * (maxlen + 16) + (r.rand_u32() & 15)];
+      lens[i] = (r.rand_u32() & 7) ? (int)(r.rand_u32() % (maxlen + 1)) : 0;
+    }
+
+    MurmurHash3_x86_32_batch(&keys[0],&lens[0],count,seed,&ref[0]);
+
+    hash(&keys[0],&lens[0],count,seed,&out[0]);
+
+    for(int i = 0; i < count; i++) if(out[i] != ref[i]) mismatches++;
+  }
+
+  return mismatches;
+}
+
+bool BatchSpeedTest ( uint32_t seed )
+{
+  const int keycount = 4096;
+  const int stride = 80;
+
+  const struct { pfBatchHash hash; uint32_t features; const char * name; } batches[] =
+  {
+    { MurmurHash3_x86_32_batch,        0,          "scalar" },
+    { MurmurHash3_x86_32_batch_avx2,   CPU_AVX2,   "avx2"   },
+    { MurmurHash3_x86_32_batch_avx512, CPU_AVX512, "avx512" },
+  };
+
+  const int nbatches = sizeof(batches) / sizeof(batches[0]);
+
+  // Fixed lengths, then 0 for lengths drawn uniformly from 1-32
+
+  const int sizes[] = { 4, 8, 12, 16, 24, 32, 64, 0 };
+  const int nsizes = sizeof(sizes) / sizeof(int);
+
+  Rand r(seed);
+
+  std::vector<uint8_t> pool(keycount * stride + 16);
+  std::vector<const void*> keys(keycount);
+  std::vector<int> lens(keycount);
+  std::vector<uint32_t> ref(keycount);
+  std::vector<uint32_t> out(keycount);
+
+  r.rand_p(&pool[0],(int)pool.size());
+
+  std::vector<int> order(keycount);
+
+  for(int i = 0; i < keycount; i++) order[i] = i;
+
+  for(int i = keycount - 1; i > 0; i--) std::swap(order[i],order[r.rand_u32() % (i + 1)]);
+
+  for(int i = 0; i < keycount; i++)
+  {
+    keys[i] = &pool[order[i] * stride + (r.rand_u32() & 15)];
+  }
+
+  printf("Multi-buffer MurmurHash3_x86_32 - %d keys at random offsets\n",keycount);
+
+  bool result = true;
+
+  for(int j = 1; j < nbatches; j++)
+  {
+    if((batches[j].features & ~GetCPUFeatures()) != 0) continue;
+
+    int mismatches = BatchCheck(batches[j].hash,seed);
+
+    printf("Check - %s against scalar, batches of 1-4095 keys of 0-300 bytes - %s\n",
+           batches[j].name,mismatches ? "MISMATCH" : "ok");
+
+    result &= (mismatches == 0);
+  }
+
+  printf("\n");
+  printf("Keylen |");
+
+  for(int j = 0; j < nbatches; j++) printf(" %6s cycles/key |",batches[j].name);
+
+  printf(" speedup\n");
+
+  for(int i = 0; i < nsizes; i++)
+  {
+    for(int k = 0; k < keycount; k++)
+    {
+      lens[k] = sizes[i] ? sizes[i] : 1 + (int)(r.rand_u32() % 32);
+    }
+
+    if(sizes[i]) printf("%6d |",sizes[i]);
+    else         printf("  1-32 |");
+
+    double scalar = 0;
+    double best = 0;
+
+    for(int j = 0; j < nbatches; j++)
+    {
+      if((batches[j].features & ~GetCPUFeatures()) != 0)
+      {
+        printf(" %17s |","n/a");
+        continue;
+      }
+
+      BatchTimer t = { batches[j].hash, &keys[0], &lens[0], keycount, seed, &out[0] };
+
+      double cycles = MedianCycles(t,0.05) / keycount;
+
+      bool match = true;
+
+      if(j == 0)
+      {
+        scalar = cycles;
+        ref = out;
+      }
+      else
+      {
+        match = (out == ref);
+        result &= match;
+      }
+
+      if(best == 0 || cycles < best) best = cycles;
+
+      printf(" %17.2f |",cycles);
+
+      if(sizes[i]) ResultsSetTest("Batch","%d-byte keys, %s",sizes[i],batches[j].name);
+      else         ResultsSetTest("Batch","1-32 byte keys, %s",batches[j].name);
+
+      ResultBegin();
+      ResultDouble("cycles_per_key",cycles);
+      ResultDouble("speedup",scalar / cycles);
+      ResultBool("match",match);
+      ResultEnd();
+
+      if(!match) printf(" MISMATCH");
+    }
+
+    printf(" %6.2fx\n",scalar / best);
+  }
+
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+// Sweep key sizes from 1 byte to 256 megs on a log scale, with the key either
+// left in cache by the re-randomization pass (warm) or flushed out to memory
+// before every call (cold). The warm curve steps down as the key outgrows
+// each cache level; we try to locate those knees automatically.
+
+void PrintKnees ( std::vector<int> & sizes, std::vector<double> & rates )
+{
+  const char * names[3] = { "L1D", "L2 ", "L3 " };
+
+  for(int level = 1; level <= 3; level++)
+  {
+    int64_t cachesize = GetCacheSize(level);
+
+    if(cachesize <= 0) continue;
+
+    // Plateau throughput while the key comfortably fits in the cache, and
+    // once it comfortably doesn't.
+
+    double inside = 0;
+    double outside = 0;
+
+    for(size_t i = 0; i < sizes.size(); i++)
+    {
+      if((sizes[i] >= cachesize / 8) && (sizes[i] <= cachesize / 2)) inside = std::max(inside,rates[i]);
+      if((sizes[i] >= cachesize * 2) && (sizes[i] <= cachesize * 8)) outside = std::max(outside,rates[i]);
+    }
+
+    printf("%s %8d KiB - ",names[level-1],(int)(cachesize / 1024));
+
+    if((inside <= 0) || (outside <= 0))
+    {
+      printf("outside sweep range\n");
+      continue;
+    }
+
+    double drop = 1.0 - (outside / inside);
+
+    if(drop < 0.05)
+    {
+      printf("no knee, %8.2f -> %8.2f MiB/sec\n",inside,outside);
+      continue;
+    }
+
+    // The knee is the first size past the in-cache plateau where we've lost
+    // at least half of the eventual drop.
+
+    double cutoff = (inside + outside) / 2;
+    int knee = 0;
+
+    for(size_t i = 0; i < sizes.size(); i++)
+    {
+      if((sizes[i] > cachesize / 2) && (rates[i] < cutoff))
+      {
+        knee = sizes[i];
+        break;
+      }
+    }
+
+    printf("knee at %10d bytes, %8.2f -> %8.2f MiB/sec (-%4.1f%%)\n",knee,inside,outside,drop * 100.0);
+
+    ResultsSetTest("SweepKnee","L%d cache, %d KiB",level,(int)(cachesize / 1024));
+
+    ResultBegin();
+    ResultInt("knee_bytes",knee);
+    ResultDouble("inside_mib_per_sec",inside);
+    ResultDouble("outside_mib_per_sec",outside);
+    ResultDouble("drop",drop);
+    ResultEnd();
+  }
+}
+
+void SweepSpeedTest ( pfHash hash, uint32_t seed )
+{
+  const int maxsize = 256 * 1024 * 1024;
+
+  // Enough trials to hash ~64 megs per size, within sane limits
+
+  const double budget = 64.0 * 1024 * 1024;
+
+  printf("Key size sweep - 1 byte to %d MiB, warm and cold cache\n",maxsize / (1024*1024));
+  printf("   Keysize |  warm MiB/sec |   warm ns/hash |  cold MiB/sec |   cold ns/hash\n");
+
+  std::vector<int> sizes;
+  std::vector<double> warmrates;
+
+  // Powers of two plus the midpoints between them
+
+  for(int64_t p = 1; p <= maxsize; p *= 2)
+  {
+    for(int step = 0; step < 2; step++)
+    {
+      int64_t size = (step == 0) ? p : (p * 3) / 2;
+
+      if((step == 1) && ((size == p) || (size > maxsize))) continue;
+
+      int blocksize = (int)size;
+
+      int trials = (int)std::max(9.0,std::min(99999.0,budget / blocksize));
+
+      ResultsSetTest("Sweep","%d-byte keys",blocksize);
+
+      double warm = SpeedTest(hash,seed,trials,blocksize,0,SPEED_WARM,NULL,NULL,NULL);
+      double cold = SpeedTest(hash,seed,trials,blocksize,0,SPEED_COLD_KEY,NULL,NULL,NULL);
+
+      double warmns = CyclesToNanos(warm);
+      double coldns = CyclesToNanos(cold);
+
+      double warmrate = (double(blocksize) * 1.0e9 / warmns) / 1048576.0;
+      double coldrate = (double(blocksize) * 1.0e9 / coldns) / 1048576.0;
+
+      printf("%10d | %13.2f | %14.1f | %13.2f | %14.1f\n",blocksize,warmrate,warmns,coldrate,coldns);
+
+      ResultBegin();
+      ResultDouble("warm_mib_per_sec",warmrate);
+      ResultDouble("warm_ns",warmns);
+      ResultDouble("cold_mib_per_sec",coldrate);
+      ResultDouble("cold_ns",coldns);
+      ResultEnd();
+
+      sizes.push_back(blocksize);
+      warmrates.push_back(warmrate);
+    }
+  }
+
+  printf("\n");
+
+  PrintKnees(sizes,warmrates);
+}
+
+//-----------------------------------------------------------------------------
+// Timed threads, shared by the scaling and trace tests. Every worker does its
+// own setup on its own CPU, then waits in WaitForStart for a common start
+// time, so no thread's timing window includes another's setup.
+
+// The worker sets 'ready' once its setup is done, and RunTimedThreads
+// publishes the start time through 'start' once every worker is ready.
+// Release stores and acquire loads order the two handshakes.
+
+struct TimedThread
+{
+  std::atomic<int> ready;
+  std::atomic<double> * start;
+};
+
+// Called by a worker after its setup - returns the start time, once the
+// wall clock has reached it
+
+double WaitForStart ( TimedThread & t )
+{
+  t.ready.store(1,std::memory_order_release);
+
+  double begin;
+
+  while((begin = t.start->load(std::memory_order_acquire)) == 0) { }
+
+  double now = GetWallTime();
+
+  while(now < begin) now = GetWallTime();
+
+  return begin;
+}
+
+// Runs worker(&work[i]) on cpus[i] for every element of 'work', which has to
+// derive from TimedThread, and returns once they've all finished.
+
+template < class thread >
+void RunTimedThreads ( ThreadFunc worker, std::vector<thread> & work, const int * cpus )
+{
+  const int threads = (int)work.size();
+
+  std::vector<void*> handles(threads);
+
+  std::atomic<double> start(0);
+
+  for(int i = 0; i < threads; i++)
+  {
+    work[i].ready.store(0);
+    work[i].start = &start;
+
+    handles[i] = StartThread(worker,&work[i],cpus[i]);
+  }
+
+  for(int i = 0; i < threads; i++)
+  {
+    while(handles[i] && !work[i].ready.load(std::memory_order_acquire)) SleepMillis(1);
+  }
+
+  // Give everyone a few milliseconds to notice the start time
+
+  start.store(GetWallTime() + 0.01,std::memory_order_release);
+
+  for(int i = 0; i < threads; i++) JoinThread(handles[i]);
+}
+
+//-----------------------------------------------------------------------------
+// Multi-threaded scaling. Each thread hashes its own private buffer over and
+// over for a fixed time while pinned to its own logical CPU. Cores are filled
+// one thread per physical core first, then SMT siblings, so the efficiency
+// column shows both where shared memory bandwidth runs out and where
+// hyperthreads stop adding throughput.
+
+// Two working sets - one that stays in each core's private cache, and one
+// that's large enough to stream from DRAM once a few threads are running.
+
+struct ScalingThread : TimedThread
+{
+  pfHash hash;
+  uint32_t seed;
+  int blocksize;
+  double duration;
+
+  double bytes;
+  double elapsed;
+};
+
+void ScalingWorker ( void * arg )
+{
+  ScalingThread * t = (ScalingThread*)arg;
+
+  // Allocate and touch the buffer on this thread, so it lands in memory
+  // local to this CPU
+
+  uint8_t * block = new uint8_t[t->blocksize];
+
+  Rand r(t->seed);
+  r.rand_p(block,t->blocksize);
+
+  uint32_t temp[16];
+
+  double begin = WaitForStart(*t);
+  double now = begin;
+
+  double bytes = 0;
+
+  do
+  {
+    t->hash(block,t->blocksize,t->seed,temp);
+    bytes += t->blocksize;
+    now = GetWallTime();
+  }
+  while(now - begin < t->duration);
+
+  t->bytes = bytes;
+  t->elapsed = now - begin;
+
+  delete [] block;
+}
+
+double ScalingRun ( pfHash hash, uint32_t seed, int blocksize, const int * cpus, int threads )
+{
+  std::vector<ScalingThread> work(threads);
+
+  for(int i = 0; i < threads; i++)
+  {
+    ScalingThread & t = work[i];
+
+    t.hash = hash;
+    t.seed = seed + i;
+    t.blocksize = blocksize;
+    t.duration = 0.5;
+    t.bytes = 0;
+    t.elapsed = 0;
+  }
+
+  RunTimedThreads(ScalingWorker,work,cpus);
+
+  double total = 0;
+
+  for(int i = 0; i < threads; i++)
+  {
+    if(work[i].elapsed > 0) total += work[i].bytes / work[i].elapsed;
+  }
+
+  return total;
+}
+
+void ScalingSpeedTest ( pfHash hash, uint32_t seed )
+{
+  const int maxcpus = 1024;
+
+  int cpus[maxcpus];
+  int cores = 0;
+
+  int ncpus = GetCPUOrder(cpus,maxcpus,cores);
+
+  const int smallsize = 256 * 1024;
+  const int largesize = 16 * 1024 * 1024;
+
+  printf("Thread scaling test - %d threads max, %d physical cores\n",ncpus,cores);
+  printf("Threads | %8d-byte keys  GB/sec efficiency | %8d-byte keys  GB/sec efficiency\n",smallsize,largesize);
+
+  double smallbase = 0;
+  double largebase = 0;
+
+  for(int threads = 1; threads <= ncpus; threads = (threads*2 > ncpus && threads < ncpus) ? ncpus : threads*2)
+  {
+    ResultsSetTest("Scaling","%d threads",threads);
+
+    double small = ScalingRun(hash,seed,smallsize,cpus,threads);
+    double large = ScalingRun(hash,seed,largesize,cpus,threads);
+
+    if(threads == 1)
+    {
+      smallbase = small;
+      largebase = large;
+    }
+
+    double smalleff = small / (smallbase * threads);
+    double largeeff = large / (largebase * threads);
+
+    printf("%7d | %29.2f %9.1f%% | %29.2f %9.1f%%%s\n",threads,small / 1.0e9,smalleff * 100.0,
+           large / 1.0e9,largeeff * 100.0,(threads > cores) ? " (SMT)" : "");
+
+    ResultBegin();
+    ResultInt("small_bytes",smallsize);
+    ResultDouble("small_gb_per_sec",small / 1.0e9);
+    ResultDouble("small_efficiency",smalleff);
+    ResultInt("large_bytes",largesize);
+    ResultDouble("large_gb_per_sec",large / 1.0e9);
+    ResultDouble("large_efficiency",largeeff);
+    ResultBool("smt",threads > cores);
+    ResultEnd();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Trace replay. Random bytes from rand_p look nothing like production keys -
+// URLs, user IDs and composite keys have their own length and entropy
+// profiles - so this replays a dump of real keys from g_traceFile. Each
+// record in the file is a 32-bit little-endian byte count followed by that
+// many bytes of key. The file is memory-mapped and hashed in place.
+
+const char * g_traceFile = NULL;
+
+struct KeyTrace
+{
+  const void * data;
+  int64_t size;
+
+  std::vector<const uint8_t*> keys;
+  std::vector<int> lengths;
+
+  double bytes;
+};
+
+bool LoadTrace ( const char * filename, KeyTrace & trace )
+{
+  trace.data = MapFile(filename,trace.size);
+  trace.bytes = 0;
+
+  if(trace.data == NULL)
+  {
+    printf("Can't map key trace '%s'\n",filename);
+    return false;
+  }
+
+  const uint8_t * base = (const uint8_t*)trace.data;
+
+  int64_t pos = 0;
+
+  while(pos < trace.size)
+  {
+    if(trace.size - pos < 4) break;
+
+    const uint8_t * p = base + pos;
+
+    uint32_t len = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+
+    if((len > 0x7FFFFFFF) || (int64_t(len) > trace.size - pos - 4)) break;
+
+    trace.keys.push_back(p + 4);
+    trace.lengths.push_back((int)len);
+    trace.bytes += len;
+
+    pos += 4 + len;
+  }
+
+  if((pos != trace.size) || trace.keys.empty())
+  {
+    printf("Key trace '%s' is truncated or corrupt at byte %lld\n",filename,(long long)pos);
+
+    UnmapFile(trace.data,trace.size);
+    trace.data = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+// Each thread replays the whole trace, starting at its own position so
+// threads aren't hashing the same keys in lockstep. The first half of the
+// run measures throughput with untimed calls, the second half times every
+// call individually for the latency distribution.
+
+struct TraceThread : TimedThread
+{
+  pfHash hash;
+  uint32_t seed;
+  const KeyTrace * trace;
+  int first;
+  double duration;
+
+  double keys;
+  double bytes;
+  double elapsed;
+  Histogram * hist;
+};
+
+void TraceWorker ( void * arg )
+{
+  TraceThread * t = (TraceThread*)arg;
+
+  const uint8_t * const * keys = &t->trace->keys[0];
+  const int * lengths = &t->trace->lengths[0];
+  const int count = (int)t->trace->keys.size();
+
+  uint32_t temp[16];
+
+  double begin = WaitForStart(*t);
+  double now = begin;
+
+  double half = t->duration / 2;
+  double nkeys = 0;
+  double bytes = 0;
+
+  int i = t->first;
+
+  do
+  {
+    for(int j = 0; j < 256; j++)
+    {
+      t->hash(keys[i],lengths[i],t->seed,temp);
+
+      bytes += lengths[i];
+      if(++i == count) i = 0;
+    }
+
+    nkeys += 256;
+    now = GetWallTime();
+  }
+  while(now - begin < half);
+
+  t->keys = nkeys;
+  t->bytes = bytes;
+  t->elapsed = now - begin;
+
+  begin = now;
+
+  do
+  {
+    for(int j = 0; j < 256; j++)
+    {
+      int64_t c = timehash(t->hash,keys[i],lengths[i],t->seed);
+
+      if(c > 0) t->hist->record((uint64_t)c);
+
+      if(++i == count) i = 0;
+    }
+
+    now = GetWallTime();
+  }
+  while(now - begin < half);
+}
+
+void TraceRun ( pfHash hash, uint32_t seed, const KeyTrace & trace, const int * cpus, int threads,
+                double & keyrate, double & byterate, Histogram & hist )
+{
+  std::vector<TraceThread> work(threads);
+  std::vector<Histogram> hists(threads);
+
+  for(int i = 0; i < threads; i++)
+  {
+    TraceThread & t = work[i];
+
+    t.hash = hash;
+    t.seed = seed;
+    t.trace = &trace;
+    t.first = int((int64_t(trace.keys.size()) * i) / threads);
+    t.duration = 1.0;
+    t.keys = 0;
+    t.bytes = 0;
+    t.elapsed = 0;
+    t.hist = &hists[i];
+  }
+
+  RunTimedThreads(TraceWorker,work,cpus);
+
+  keyrate = 0;
+  byterate = 0;
+  hist.clear();
+
+  for(int i = 0; i < threads; i++)
+  {
+    if(work[i].elapsed > 0)
+    {
+      keyrate += work[i].keys / work[i].elapsed;
+      byterate += work[i].bytes / work[i].elapsed;
+    }
+
+    hist.add(hists[i]);
+  }
+}
+
+void TraceSpeedTest ( pfHash hash, int hashsize, uint32_t seed )
+{
+  if(g_traceFile == NULL) return;
+
+  KeyTrace trace;
+
+  if(!LoadTrace(g_traceFile,trace)) return;
+
+  const int maxcpus = 1024;
+
+  int cpus[maxcpus];
+  int cores = 0;
+
+  int ncpus = GetCPUOrder(cpus,maxcpus,cores);
+
+  // Latencies are corrected for the timer and call overhead like the small
+  // key test's
+
+  double overhead = GetCallOverhead(hashsize);
+
+  printf("Trace replay test - '%s', %d keys, %.1f bytes/key mean\n",
+         g_traceFile,(int)trace.keys.size(),trace.bytes / trace.keys.size());
+  printf("Threads |  Mkeys/sec    MiB/sec efficiency | latency ns/hash    p50    p90    p99  p99.9      max\n");
+
+  double base = 0;
+
+  for(int threads = 1; threads <= ncpus; threads = (threads*2 > ncpus && threads < ncpus) ? ncpus : threads*2)
+  {
+    double keyrate, byterate;
+    Histogram hist;
+
+    ResultsSetTest("Trace","%s, %d threads",g_traceFile,threads);
+
+    TraceRun(hash,seed,trace,cpus,threads,keyrate,byterate,hist);
+
+    if(threads == 1) base = keyrate;
+
+    printf("%7d | %10.2f %10.2f %9.1f%% |                ",threads,keyrate / 1.0e6,byterate / 1048576.0,
+           keyrate / (base * threads) * 100.0);
+
+    ResultBegin();
+    ResultDouble("mkeys_per_sec",keyrate / 1.0e6);
+    ResultDouble("mib_per_sec",byterate / 1048576.0);
+    ResultDouble("efficiency",keyrate / (base * threads));
+
+    const double pct[5] = { 50, 90, 99, 99.9, 100 };
+    const char * keys[5] = { "p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_ns" };
+
+    for(int i = 0; i < 5; i++)
+    {
+      double c = std::max(0.0,hist.percentile(pct[i]) - overhead);
+
+      printf(i < 4 ? " %6.1f" : " %8.1f",CyclesToNanos(c));
+
+      ResultDouble(keys[i],CyclesToNanos(c));
+    }
+
+    printf("%s\n",(threads > cores) ? " (SMT)" : "");
+
+    ResultBool("smt",threads > cores);
+    ResultEnd();
+  }
+
+  UnmapFile(trace.data,trace.size);
 }
 
 //-----------------------------------------------------------------------------
@@ -1,8 +1,188 @@
 #pragma once
 
 #include "Types.h"
+#include "Random.h"
+#include "Results.h"
+
+#include <stdio.h>
+
+// SpeedTest flags - SPEED_COLD_KEY flushes the key from the cache before
+// every timed call, SPEED_COLD_TABLES flushes the hash's lookup tables (see
+// GetHashTables), and SPEED_COLD_EVICT sweeps an eviction buffer twice the
+// size of the last-level cache, which also evicts the hash's code.
+
+enum SpeedFlags
+{
+  SPEED_WARM        = 0,
+  SPEED_COLD_KEY    = 1,
+  SPEED_COLD_TABLES = 2,
+  SPEED_COLD_EVICT  = 4,
+};
+
+// Report IPC, branch and cache misses per hash from the hardware counters
+
+extern bool g_speedCounters;
+
+// Report package energy per byte for the bulk speed test from the RAPL
+// powercap counters, over g_speedEnergyTime seconds of hashing
+
+extern bool g_speedEnergy;
+extern double g_speedEnergyTime;
+
+// Adaptive sampling - each measurement stops once the 95% confidence
+// interval of its median is narrower than g_speedPrecision (relative), or
+// after g_speedTimeLimit seconds. 0 disables either limit.
+
+extern double g_speedPrecision;
+extern double g_speedTimeLimit;
+
+void PrintTimerInfo ( void );
+
+// Cycles spent on the timestamp reads alone, and on the timestamp reads plus
+// an empty call writing a 'hashsize'-byte result. Measured once, then cached.
+
+double GetTimerOverhead ( void );
+double GetCallOverhead ( int hashsize );
+
+double CyclesToNanos ( double cycles );
 
 void BulkSpeedTest ( pfHash hash, uint32_t seed );
 void TinySpeedTest ( pfHash hash, int hashsize, int keysize, uint32_t seed, bool verbose, double & outCycles );
+void LatencyThroughputTest ( pfHash hash, int hashsize, uint32_t seed );
+void AlignmentSpeedTest ( pfHash hash, uint32_t seed );
+void ColdSpeedTest ( pfHash hash, int hashsize, uint32_t seed );
+
+// SpookyHash Init/Update/Final at chunk sizes from 1 byte to 1 MiB, against
+// one-shot Hash128. Returns false if any chunking changes the digest.
+
+bool SpookyStreamingTest ( uint32_t seed );
+
+// Bulk bytes/cycle of 'hash' against 'reference' at key lengths from 64
+// bytes to 256 KiB
+
+void BulkCompareTest ( pfHash hash, pfHash reference, const char * refname, uint32_t seed );
+
+// Cycles per key of the AVX2 and AVX-512 multi-buffer MurmurHash3_x86_32
+// against the scalar one, at fixed and mixed key lengths. Before timing,
+// each is checked against the scalar hash at odd batch sizes and lengths
+// from 0 to 300 bytes. Returns false if any of them disagrees with it.
+
+bool BatchSpeedTest ( uint32_t seed );
+
+// Keys with lengths drawn from uniform, Zipf and bimodal distributions, plus
+// an empirical "length count" histogram from g_lengthFile if it's set.
+
+extern const char * g_lengthFile;
+
+void VariableLengthSpeedTest ( pfHash hash, int hashsize, uint32_t seed );
+void SweepSpeedTest ( pfHash hash, uint32_t seed );
+void ScalingSpeedTest ( pfHash hash, uint32_t seed );
+
+// Replays the length-prefixed keys in g_traceFile on 1..N threads
+
+extern const char * g_traceFile;
+
+void TraceSpeedTest ( pfHash hash, int hashsize, uint32_t seed );
+
+//-----------------------------------------------------------------------------
+// Inlined speed test. Everything above calls hashes through a pfHash pointer,
+// which keeps the compiler from inlining them, propagating a constant key
+// length into them or interleaving consecutive calls - all things it does
+// when a hash is used directly in e.g. a hash table lookup. This path runs
+// the same independent-key workload as LatencyThroughputTest through a hasher
+// functor type instead, with the key length as a compile-time constant, and
+// reports it next to the indirect-call cost.
+
+// The hash implementations are built with link-time optimization (see
+// CMakeLists.txt) so the hash bodies can be inlined across translation units.
+
+template < pfHash hash >
+struct DirectHash
+{
+  FORCE_INLINE void operator () ( const void * key, int len, uint32_t seed, void * out ) const
+  {
+    hash(key,len,seed,out);
+  }
+};
+
+int64_t timestream ( pfHash hash, const uint8_t * keys, int stride, int len, int count, uint32_t seed, uint32_t * out, int outwords );
+
+void PrintInlinedRow ( int len, std::vector<double> & indirect, std::vector<double> & inlined );
+
+template < class hasher, int len >
+NEVER_INLINE int64_t timestream_inlined ( const uint8_t * keys, int stride, int count, uint32_t seed, uint32_t * out, int outwords )
+{
+  hasher h;
+
+  uint64_t begin = timer_start();
+
+  for(int i = 0; i < count; i++)
+  {
+    h(keys + i*stride,len,seed,out + i*outwords);
+  }
+
+  uint64_t end = timer_end();
+
+  return end-begin;
+}
+
+template < class hasher, int len >
+struct InlinedSpeedLengths
+{
+  static void run ( pfHash hash, const uint8_t * keys, int stride, int keycount, uint32_t seed, uint32_t * out, int outwords )
+  {
+    InlinedSpeedLengths<hasher,len-1>::run(hash,keys,stride,keycount,seed,out,outwords);
+
+    const int reps = 99;
+
+    std::vector<double> indirect;
+    std::vector<double> inlined;
+
+    ResultsSetTest("Inlined","%d-byte keys",len);
+
+    for(int rep = 0; rep < reps; rep++)
+    {
+      indirect.push_back(double(timestream(hash,keys,stride,len,keycount,seed,out,outwords)) / keycount);
+      inlined.push_back(double(timestream_inlined<hasher,len>(keys,stride,keycount,seed,out,outwords)) / keycount);
+    }
+
+    PrintInlinedRow(len,indirect,inlined);
+  }
+};
+
+template < class hasher >
+struct InlinedSpeedLengths<hasher,0>
+{
+  static void run ( pfHash, const uint8_t *, int, int, uint32_t, uint32_t *, int )
+  {
+  }
+};
+
+template < class hasher >
+void InlinedSpeedTest ( pfHash hash, int hashsize, uint32_t seed )
+{
+  const int keycount = 2048;
+  const int maxlen = 31;
+
+  const int stride = (maxlen + 7) & ~7;
+  const int outwords = (hashsize + 3) / 4;
+
+  printf("Inlined vs. indirect speed test - %d independent keys\n",keycount);
+  printf("Keylen | indirect cycles/hash | inlined cycles/hash | speedup\n");
+
+  Rand r(seed);
+
+  std::vector<uint8_t> keys(keycount * stride);
+  std::vector<uint32_t> out(keycount * outwords);
+
+  r.rand_p(&keys[0],(int)keys.size());
+
+  InlinedSpeedLengths<hasher,maxlen>::run(hash,&keys[0],stride,keycount,seed,&out[0],outwords);
+}
+
+// Runs InlinedSpeedTest for any of the built-in hashes. Returns false if
+// there's no inlined version of 'hash'.
+
+bool RunInlinedSpeedTest ( pfHash hash, int hashsize, uint32_t seed );
 
 //-----------------------------------------------------------------------------
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Types.h"
+#include "Results.h"
 
 #include <math.h>
 #include <vector>
@@ -182,6 +183,10 @@ double TestDistribution ( std::vector<hashtype> & hashes, bool drawDiagram )
   if(pct >= 1.0) printf(" !!!!! ");
   printf("\n");
 
+  ResultDouble("worst_bias",worst);
+  ResultInt("bias_window_bits",worstWidth);
+  ResultInt("bias_window_start",worstStart);
+
   return worst;
 }
 
@@ -192,6 +197,9 @@ bool TestHashList ( std::vector<hashtype> & hashes, std::vector<hashtype> & coll
 {
   bool result = true;
 
+  ResultBegin();
+  ResultInt("keys",(int64_t)hashes.size());
+
   {
     size_t count = hashes.size();
 
@@ -233,6 +241,9 @@ bool TestHashList ( std::vector<hashtype> & hashes, std::vector<hashtype> & coll
     }
 
     printf("\n");
+
+    ResultDouble("collisions_expected",expected);
+    ResultDouble("collisions_actual",collcount);
   }
 
   //----------
@@ -242,6 +253,9 @@ bool TestHashList ( std::vector<hashtype> & hashes, std::vector<hashtype> & coll
     TestDistribution(hashes,drawDiagram);
   }
 
+  ResultBool("pass",result);
+  ResultEnd();
+
   return result;
 }
 
@@ -1,5 +1,7 @@
 #include "Platform.h"
 
+#include <string.h>
+
 /*
  * This file is derived from crc32.c from the zlib-1.1.3 distribution
  * by Jean-loup Gailly and Mark Adler.
@@ -69,6 +71,12 @@ static const uint32_t crc_table[256] = {
   0x2d02ef8dL
 };
 
+const void * crc32_table ( size_t & size )
+{
+  size = sizeof(crc_table);
+  return crc_table;
+}
+
 /* ========================================================================= */
 
 #define DO1(buf) crc = crc_table[((int)crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
@@ -98,3 +106,467 @@ void crc32 ( const void * key, int len, uint32_t seed, void * out )
 
   *(uint32_t*)out = crc;
 }
+
+/* ========================================================================
+ * Slicing-by-8 and slicing-by-16. crc_slice[k][i] is the CRC of byte i
+ * followed by k zero bytes, so 8 or 16 bytes can be folded in with one
+ * independent table lookup each instead of a chain of dependent ones.
+ * Same polynomial and conventions as crc32 above, so the results match it
+ * exactly. Assumes a little-endian host, like the rest of SMHasher.
+ */
+
+static uint32_t crc_slice[16][256];
+
+struct CrcSliceInit
+{
+  CrcSliceInit ( void )
+  {
+    for(int i = 0; i < 256; i++)
+    {
+      uint32_t c = crc_table[i];
+
+      crc_slice[0][i] = c;
+
+      for(int k = 1; k < 16; k++)
+      {
+        c = crc_table[c & 0xff] ^ (c >> 8);
+        crc_slice[k][i] = c;
+      }
+    }
+  }
+};
+
+static CrcSliceInit crc_slice_init;
+
+const void * crc32_slice_table ( size_t & size )
+{
+  size = sizeof(crc_slice);
+  return crc_slice;
+}
+
+static inline uint32_t load32 ( const uint8_t * p )
+{
+  uint32_t v;
+  memcpy(&v,p,4);
+  return v;
+}
+
+void crc32_slice8 ( const void * key, int len, uint32_t seed, void * out )
+{
+  uint8_t * buf = (uint8_t*)key;
+  uint32_t crc = seed ^ 0xffffffffL;
+
+  while(len >= 8)
+  {
+    uint32_t a = load32(buf) ^ crc;
+    uint32_t b = load32(buf+4);
+
+    crc = crc_slice[7][ a        & 0xff] ^ crc_slice[6][(a >>  8) & 0xff] ^
+          crc_slice[5][(a >> 16) & 0xff] ^ crc_slice[4][ a >> 24        ] ^
+          crc_slice[3][ b        & 0xff] ^ crc_slice[2][(b >>  8) & 0xff] ^
+          crc_slice[1][(b >> 16) & 0xff] ^ crc_slice[0][ b >> 24        ];
+
+    buf += 8;
+    len -= 8;
+  }
+
+  while(len--)
+  {
+    DO1(buf);
+  }
+
+  crc ^= 0xffffffffL;
+
+  *(uint32_t*)out = crc;
+}
+
+static uint32_t crc32_slice16_update ( uint32_t crc, const uint8_t * buf, int len )
+{
+  while(len >= 16)
+  {
+    uint32_t a = load32(buf) ^ crc;
+    uint32_t b = load32(buf+4);
+    uint32_t c = load32(buf+8);
+    uint32_t d = load32(buf+12);
+
+    crc = crc_slice[15][ a        & 0xff] ^ crc_slice[14][(a >>  8) & 0xff] ^
+          crc_slice[13][(a >> 16) & 0xff] ^ crc_slice[12][ a >> 24        ] ^
+          crc_slice[11][ b        & 0xff] ^ crc_slice[10][(b >>  8) & 0xff] ^
+          crc_slice[ 9][(b >> 16) & 0xff] ^ crc_slice[ 8][ b >> 24        ] ^
+          crc_slice[ 7][ c        & 0xff] ^ crc_slice[ 6][(c >>  8) & 0xff] ^
+          crc_slice[ 5][(c >> 16) & 0xff] ^ crc_slice[ 4][ c >> 24        ] ^
+          crc_slice[ 3][ d        & 0xff] ^ crc_slice[ 2][(d >>  8) & 0xff] ^
+          crc_slice[ 1][(d >> 16) & 0xff] ^ crc_slice[ 0][ d >> 24        ];
+
+    buf += 16;
+    len -= 16;
+  }
+
+  while(len--)
+  {
+    DO1(buf);
+  }
+
+  return crc;
+}
+
+void crc32_slice16 ( const void * key, int len, uint32_t seed, void * out )
+{
+  uint32_t crc = seed ^ 0xffffffffL;
+
+  crc = crc32_slice16_update(crc,(const uint8_t*)key,len);
+
+  crc ^= 0xffffffffL;
+
+  *(uint32_t*)out = crc;
+}
+
+/* ========================================================================
+ * CRC-32C (Castagnoli), the polynomial the SSE4.2 CRC32 instruction
+ * implements. The software version is slicing-by-8 over tables built at
+ * startup and is used when the instruction isn't available, so both give
+ * the same results.
+ *
+ * crc32c_hw needs SSE4.2 and PCLMULQDQ - the dispatch layer only binds it
+ * where cpuid reports both. On other architectures it's the software version.
+ *
+ * The instruction has a 3-cycle latency but a throughput of one per cycle,
+ * so long buffers are split into three streams that are CRC'd in lockstep
+ * and then combined - the CRC of A followed by B is the CRC of A shifted
+ * over |B| zero bytes, xored with the CRC of B from a zero start, and the
+ * shift is a multiplication by x^(8|B|) modulo the polynomial. That takes
+ * one carry-less multiply by x^(8|B|-33) and one CRC32 instruction, which
+ * reduces the 64-bit product and supplies the remaining x^32 (the other x
+ * comes from the reflected product being one bit short). That's cheap
+ * enough to use streams of 8 KiB, then 256 bytes, then 64 bytes, with only
+ * the last 191 bytes or less CRC'd serially.
+ */
+
+#define CRC32C_POLY  0x82f63b78
+#define CRC32C_LONG   8192
+#define CRC32C_MEDIUM 256
+#define CRC32C_SHORT  64
+
+static uint32_t crc32c_slice[8][256];
+
+// x^n modulo the polynomial, in the bit-reflected order the CRC registers
+// use (so x^0 is the top bit)
+
+static uint32_t crc32c_xpow ( int n )
+{
+  uint32_t p = 0x80000000;
+
+  for(int i = 0; i < n; i++) p = (p & 1) ? (p >> 1) ^ CRC32C_POLY : (p >> 1);
+
+  return p;
+}
+
+// Combine constants for three streams of 'block' bytes - x^(8*block-33)
+// shifts the middle stream's CRC over the last one, x^(16*block-33) the
+// first stream's over both
+
+static uint32_t crc32c_long[2];
+static uint32_t crc32c_medium[2];
+static uint32_t crc32c_short[2];
+
+struct Crc32cInit
+{
+  Crc32cInit ( void )
+  {
+    for(int i = 0; i < 256; i++)
+    {
+      uint32_t c = i;
+
+      for(int j = 0; j < 8; j++) c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : (c >> 1);
+
+      crc32c_slice[0][i] = c;
+    }
+
+    for(int i = 0; i < 256; i++)
+    {
+      uint32_t c = crc32c_slice[0][i];
+
+      for(int k = 1; k < 8; k++)
+      {
+        c = crc32c_slice[0][c & 0xff] ^ (c >> 8);
+        crc32c_slice[k][i] = c;
+      }
+    }
+
+    crc32c_long[0]   = crc32c_xpow(8 * CRC32C_LONG - 33);
+    crc32c_long[1]   = crc32c_xpow(16 * CRC32C_LONG - 33);
+    crc32c_medium[0] = crc32c_xpow(8 * CRC32C_MEDIUM - 33);
+    crc32c_medium[1] = crc32c_xpow(16 * CRC32C_MEDIUM - 33);
+    crc32c_short[0]  = crc32c_xpow(8 * CRC32C_SHORT - 33);
+    crc32c_short[1]  = crc32c_xpow(16 * CRC32C_SHORT - 33);
+  }
+};
+
+static Crc32cInit crc32c_init;
+
+const void * crc32c_table ( size_t & size )
+{
+  size = sizeof(crc32c_slice);
+  return crc32c_slice;
+}
+
+void crc32c_sw ( const void * key, int len, uint32_t seed, void * out )
+{
+  uint8_t * buf = (uint8_t*)key;
+  uint32_t crc = seed ^ 0xffffffffL;
+
+  while(len >= 8)
+  {
+    uint32_t a = load32(buf) ^ crc;
+    uint32_t b = load32(buf+4);
+
+    crc = crc32c_slice[7][ a        & 0xff] ^ crc32c_slice[6][(a >>  8) & 0xff] ^
+          crc32c_slice[5][(a >> 16) & 0xff] ^ crc32c_slice[4][ a >> 24        ] ^
+          crc32c_slice[3][ b        & 0xff] ^ crc32c_slice[2][(b >>  8) & 0xff] ^
+          crc32c_slice[1][(b >> 16) & 0xff] ^ crc32c_slice[0][ b >> 24        ];
+
+    buf += 8;
+    len -= 8;
+  }
+
+  while(len--)
+  {
+    crc = crc32c_slice[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+  }
+
+  crc ^= 0xffffffffL;
+
+  *(uint32_t*)out = crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+
+static inline uint64_t load64 ( const uint8_t * p )
+{
+  uint64_t v;
+  memcpy(&v,p,8);
+  return v;
+}
+
+// Runs three streams of 'block' bytes each, starting at buf, buf+block and
+// buf+2*block, and folds them back into one CRC.
+
+__attribute__((target("sse4.2,pclmul")))
+static inline uint32_t crc32c_hw_3way ( uint32_t crc, const uint8_t * buf, int block, const uint32_t shift[2] )
+{
+  uint64_t crc0 = crc;
+  uint64_t crc1 = 0;
+  uint64_t crc2 = 0;
+
+  const uint8_t * end = buf + block;
+
+  do
+  {
+    crc0 = _mm_crc32_u64(crc0,load64(buf));
+    crc1 = _mm_crc32_u64(crc1,load64(buf + block));
+    crc2 = _mm_crc32_u64(crc2,load64(buf + 2*block));
+    buf += 8;
+  }
+  while(buf < end);
+
+  __m128i c = _mm_set_epi64x((int64_t)crc1,(int64_t)crc0);
+  __m128i k = _mm_set_epi64x(shift[0],shift[1]);
+
+  __m128i p = _mm_xor_si128(_mm_clmulepi64_si128(c,k,0x00),_mm_clmulepi64_si128(c,k,0x11));
+
+  return (uint32_t)_mm_crc32_u64(0,(uint64_t)_mm_cvtsi128_si64(p)) ^ (uint32_t)crc2;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+void crc32c_hw ( const void * key, int len, uint32_t seed, void * out )
+{
+  const uint8_t * buf = (const uint8_t*)key;
+  uint32_t crc = seed ^ 0xffffffffL;
+
+  while(len >= 3 * CRC32C_LONG)
+  {
+    crc = crc32c_hw_3way(crc,buf,CRC32C_LONG,crc32c_long);
+    buf += 3 * CRC32C_LONG;
+    len -= 3 * CRC32C_LONG;
+  }
+
+  while(len >= 3 * CRC32C_MEDIUM)
+  {
+    crc = crc32c_hw_3way(crc,buf,CRC32C_MEDIUM,crc32c_medium);
+    buf += 3 * CRC32C_MEDIUM;
+    len -= 3 * CRC32C_MEDIUM;
+  }
+
+  while(len >= 3 * CRC32C_SHORT)
+  {
+    crc = crc32c_hw_3way(crc,buf,CRC32C_SHORT,crc32c_short);
+    buf += 3 * CRC32C_SHORT;
+    len -= 3 * CRC32C_SHORT;
+  }
+
+  uint64_t crc64 = crc;
+
+  while(len >= 8)
+  {
+    crc64 = _mm_crc32_u64(crc64,load64(buf));
+    buf += 8;
+    len -= 8;
+  }
+
+  crc = (uint32_t)crc64;
+
+  while(len--)
+  {
+    crc = _mm_crc32_u8(crc,*buf++);
+  }
+
+  crc ^= 0xffffffffL;
+
+  *(uint32_t*)out = crc;
+}
+
+#else
+
+void crc32c_hw ( const void * key, int len, uint32_t seed, void * out )
+{
+  crc32c_sw(key,len,seed,out);
+}
+
+#endif
+
+/* ========================================================================
+ * CRC-32 by carry-less multiplication, after Intel's "Fast CRC Computation
+ * for Generic Polynomials Using PCLMULQDQ Instruction" and the Linux
+ * kernel's crc32-pclmul. Four 128-bit lanes are folded forward 64 bytes at
+ * a time, then folded into one lane, reduced to 64 bits and finished with
+ * a Barrett reduction. The constants are x^k mod P for the fold distances,
+ * bit-reflected like the CRC itself, so the result is bit-identical to
+ * crc32.
+ *
+ * Folding needs at least the four lanes' worth of input. From there on it
+ * beats slicing-by-16 at every length (2x at 64 bytes, 8x at 4K on a
+ * Skylake-class Xeon), so keys shorter than CRC32_CLMUL_THRESHOLD and the
+ * tail after the last full 16-byte block go through crc32_slice16's loop.
+ *
+ * Needs PCLMULQDQ and SSE4.1, which the dispatch layer checks for.
+ */
+
+#define CRC32_CLMUL_THRESHOLD 64
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+#include <wmmintrin.h>
+#include <smmintrin.h>
+
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_fold ( uint32_t crc, const uint8_t * buf, int len )
+{
+  const __m128i k1k2 = _mm_set_epi64x(0x1c6e41596LL,0x154442bd4LL);   // x^(4*128+32), x^(4*128-32)
+  const __m128i k3k4 = _mm_set_epi64x(0x0ccaa009eLL,0x1751997d0LL);   // x^(128+32), x^(128-32)
+  const __m128i k5   = _mm_set_epi64x(0,0x163cd6124LL);                // x^64
+  const __m128i poly = _mm_set_epi64x(0x1f7011641LL,0x1db710641LL);   // u = x^64 / P, P
+  const __m128i mask = _mm_set_epi32(0,0,0,-1);
+
+  __m128i x1 = _mm_loadu_si128((const __m128i*)(buf +  0));
+  __m128i x2 = _mm_loadu_si128((const __m128i*)(buf + 16));
+  __m128i x3 = _mm_loadu_si128((const __m128i*)(buf + 32));
+  __m128i x4 = _mm_loadu_si128((const __m128i*)(buf + 48));
+
+  x1 = _mm_xor_si128(x1,_mm_cvtsi32_si128((int)crc));
+
+  buf += 64;
+  len -= 64;
+
+  // Fold 4 x 128 bits forward over each 64-byte block
+
+  while(len >= 64)
+  {
+    __m128i t1 = _mm_clmulepi64_si128(x1,k1k2,0x11);
+    __m128i t2 = _mm_clmulepi64_si128(x2,k1k2,0x11);
+    __m128i t3 = _mm_clmulepi64_si128(x3,k1k2,0x11);
+    __m128i t4 = _mm_clmulepi64_si128(x4,k1k2,0x11);
+
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1,k1k2,0x00),t1);
+    x2 = _mm_xor_si128(_mm_clmulepi64_si128(x2,k1k2,0x00),t2);
+    x3 = _mm_xor_si128(_mm_clmulepi64_si128(x3,k1k2,0x00),t3);
+    x4 = _mm_xor_si128(_mm_clmulepi64_si128(x4,k1k2,0x00),t4);
+
+    x1 = _mm_xor_si128(x1,_mm_loadu_si128((const __m128i*)(buf +  0)));
+    x2 = _mm_xor_si128(x2,_mm_loadu_si128((const __m128i*)(buf + 16)));
+    x3 = _mm_xor_si128(x3,_mm_loadu_si128((const __m128i*)(buf + 32)));
+    x4 = _mm_xor_si128(x4,_mm_loadu_si128((const __m128i*)(buf + 48)));
+
+    buf += 64;
+    len -= 64;
+  }
+
+  // Fold the four lanes into one, then any remaining 16-byte blocks
+
+  __m128i t;
+
+  t  = _mm_clmulepi64_si128(x1,k3k4,0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x00),t),x2);
+
+  t  = _mm_clmulepi64_si128(x1,k3k4,0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x00),t),x3);
+
+  t  = _mm_clmulepi64_si128(x1,k3k4,0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x00),t),x4);
+
+  while(len >= 16)
+  {
+    t  = _mm_clmulepi64_si128(x1,k3k4,0x11);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x00),t);
+    x1 = _mm_xor_si128(x1,_mm_loadu_si128((const __m128i*)buf));
+
+    buf += 16;
+    len -= 16;
+  }
+
+  // 128 -> 64 bits, appending the 32 zero bits a CRC implies
+
+  x1 = _mm_xor_si128(_mm_srli_si128(x1,8),_mm_clmulepi64_si128(x1,k3k4,0x10));
+
+  // 64 -> 32 bits
+
+  t  = _mm_srli_si128(x1,4);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1,mask),k5,0x00),t);
+
+  // Barrett reduction, 64 -> 32 bits
+
+  t  = x1;
+  x1 = _mm_clmulepi64_si128(_mm_and_si128(x1,mask),poly,0x10);
+  x1 = _mm_clmulepi64_si128(_mm_and_si128(x1,mask),poly,0x00);
+  x1 = _mm_xor_si128(x1,t);
+
+  return (uint32_t)_mm_extract_epi32(x1,1);
+}
+
+#endif
+
+void crc32_clmul ( const void * key, int len, uint32_t seed, void * out )
+{
+  const uint8_t * buf = (const uint8_t*)key;
+  uint32_t crc = seed ^ 0xffffffffL;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+  if(len >= CRC32_CLMUL_THRESHOLD)
+  {
+    int folded = len & ~15;
+
+    crc = crc32_fold(crc,buf,folded);
+
+    buf += folded;
+    len -= folded;
+  }
+#endif
+
+  crc = crc32_slice16_update(crc,buf,len);
+
+  crc ^= 0xffffffffL;
+
+  *(uint32_t*)out = crc;
+}
@@ -4,9 +4,16 @@
 #include "SpeedTest.h"
 #include "AvalancheTest.h"
 #include "DifferentialTest.h"
+#include "Environment.h"
+#include "HashTableTest.h"
+#include "Baseline.h"
+#include "Results.h"
+#include "Dispatch.h"
 
 #include <stdio.h>
 #include <time.h>
+#include <string.h>
+#include <stdlib.h>
 
 //-----------------------------------------------------------------------------
 // Configuration. TODO - move these to command-line flags
@@ -15,6 +22,11 @@ bool g_testAll = false;
 
 bool g_testSanity      = false;
 bool g_testSpeed       = false;
+bool g_testSpeedSweep  = false;
+bool g_testAlignment   = false;
+bool g_testColdCache   = false;
+bool g_testHashTable   = false;
+bool g_testScaling     = false;
 bool g_testDiff        = false;
 bool g_testDiffDist    = false;
 bool g_testAvalanche   = false;
@@ -28,9 +40,75 @@ bool g_testText        = false;
 bool g_testZeroes      = false;
 bool g_testSeed        = false;
 
+// Benchmark CPU. With g_strictEnvironment set we refuse to run if the
+// environment check finds anything that would make speed results noisy.
+
+int  g_benchCPU          = 2;
+bool g_strictEnvironment = false;
+
+// Speed regression baselines - save this run's speed distributions to
+// g_baselineSave, and/or compare them against g_baselineFile and exit with a
+// nonzero status on a significant slowdown.
+
+const char * g_baselineSave = NULL;
+const char * g_baselineFile = NULL;
+
+// Every test also writes a JSON record to g_resultsFile as it finishes
+
+const char * g_resultsFile = NULL;
+
+//-----------------------------------------------------------------------------
+// Implementations that depend on instruction set extensions, fastest first.
+// Registry entries that point at one of these lists get bound to the first
+// variant the CPU supports by BindHashes, and every supported variant has to
+// pass the entry's verification test.
+
+HashVariant g_crc32ClmulVariants[] =
+{
+  { crc32_clmul,   CPU_PCLMUL | CPU_SSE41, "pclmul" },
+  { crc32_slice16, 0,                      "slicing-by-16" },
+  { NULL, 0, NULL }
+};
+
+HashVariant g_crc32cVariants[] =
+{
+  { crc32c_hw,     CPU_SSE42 | CPU_PCLMUL, "sse4.2+pclmul" },
+  { crc32c_sw,     0,                      "slicing-by-8" },
+  { NULL, 0, NULL }
+};
+
+// The CityHashCrc functions have no portable fallback - without SSE4.2 the
+// entries are unavailable.
+
+#ifdef SMHASHER_CITY_CRC
+
+HashVariant g_cityCrc128Variants[] =
+{
+  { CityHashCrc128_test, CPU_SSE42, "sse4.2" },
+  { NULL, 0, NULL }
+};
+
+HashVariant g_cityCrc128SeedVariants[] =
+{
+  { CityHashCrc128WithSeed_test, CPU_SSE42, "sse4.2" },
+  { NULL, 0, NULL }
+};
+
+HashVariant g_cityCrc256Variants[] =
+{
+  { CityHashCrc256_test, CPU_SSE42, "sse4.2" },
+  { NULL, 0, NULL }
+};
+
+#endif
+
 //-----------------------------------------------------------------------------
 // This is the list of all hashes that SMHasher can test.
 
+// For entries with a variant list, 'hash' is replaced with the selected
+// variant at startup and 'variant' names it. If the CPU supports none of
+// the variants 'hash' is NULL and the entry can't be tested.
+
 struct HashInfo
 {
   pfHash hash;
@@ -38,6 +116,8 @@ struct HashInfo
   uint32_t verification;
   const char * name;
   const char * desc;
+  HashVariant * variants;
+  const char * variant;
 };
 
 HashInfo g_hashes[] =
@@ -47,6 +127,11 @@ HashInfo g_hashes[] =
   { DoNothingHash,       128, 0x00000000, "donothing128", "Do-Nothing function (only valid for measuring call overhead)" },
 
   { crc32,                32, 0x3719DB20, "crc32",       "CRC-32" },
+  { crc32_slice8,         32, 0x3719DB20, "crc32_s8",    "CRC-32, slicing-by-8" },
+  { crc32_slice16,        32, 0x3719DB20, "crc32_s16",   "CRC-32, slicing-by-16" },
+  { crc32_slice16,        32, 0x3719DB20, "crc32_clmul", "CRC-32, PCLMULQDQ folding above 64 bytes", g_crc32ClmulVariants },
+  { crc32c_sw,            32, 0x6E6071BD, "crc32c",      "CRC-32C, SSE4.2 with 3-way interleave where available", g_crc32cVariants },
+  { crc32c_sw,            32, 0x6E6071BD, "crc32c_sw",   "CRC-32C, slicing-by-8" },
 
   { md5_32,               32, 0xC10C356B, "md5_32a",     "MD5, first 32 bits of result" },
   { sha1_32a,             32, 0xF9376EA7, "sha1_32a",    "SHA1, first 32 bits of result" },
@@ -61,6 +146,12 @@ HashInfo g_hashes[] =
   { CityHash64_test,      64, 0x25A20825, "City64",      "Google CityHash64WithSeed" },
   { CityHash128_test,    128, 0x6531F54E, "City128",     "Google CityHash128WithSeed" },
 
+#ifdef SMHASHER_CITY_CRC
+  { CityHashCrc128_test,         128, 0xA54948EA, "CityCrc128",     "Google CityHashCrc128 (unseeded)", g_cityCrc128Variants },
+  { CityHashCrc128WithSeed_test, 128, 0xD4389C97, "CityCrc128Seed", "Google CityHashCrc128WithSeed", g_cityCrc128SeedVariants },
+  { CityHashCrc256_test,         256, 0x25A337F8, "CityCrc256",     "Google CityHashCrc256 (unseeded)", g_cityCrc256Variants },
+#endif
+
   { SpookyHash64_test,    32, 0x3F798BBB, "Spooky32",    "Bob Jenkins' SpookyHash, 32-bit result" },
   { SpookyHash64_test,    64, 0xA7F955F1, "Spooky64",    "Bob Jenkins' SpookyHash, 64-bit result" },
   { SpookyHash128_test,  128, 0x8D263080, "Spooky128",   "Bob Jenkins' SpookyHash, 128-bit result" },
@@ -90,9 +181,48 @@ HashInfo * findHash ( const char * name )
   return NULL;
 }
 
+//-----------------------------------------------------------------------------
+// Binds every entry that has a variant list to the fastest variant this CPU
+// supports.
+
+void BindHashes ( void )
+{
+  for(size_t i = 0; i < sizeof(g_hashes) / sizeof(HashInfo); i++)
+  {
+    HashInfo * info = & g_hashes[i];
+
+    if(info->variants == NULL) continue;
+
+    const HashVariant * v = SelectVariant(info->variants);
+
+    info->hash    = v ? v->hash : NULL;
+    info->variant = v ? v->name : NULL;
+  }
+}
+
 //-----------------------------------------------------------------------------
 // Self-test on startup - verify that all installed hashes work correctly.
 
+// Every variant the CPU supports is checked, not just the bound one, so a
+// broken SIMD path can't hide behind a faster one.
+
+bool VerifyVariants ( HashInfo * info, bool verbose )
+{
+  bool pass = true;
+
+  if(info->hash) pass &= VerificationTest(info->hash,info->hashbits,info->verification,verbose);
+
+  for(HashVariant * v = info->variants; v && v->hash; v++)
+  {
+    if((v->hash == info->hash) || !VariantSupported(*v)) continue;
+
+    if(verbose) printf("%16s - %-12s - ","",v->name);
+    pass &= VerificationTest(v->hash,info->hashbits,info->verification,verbose);
+  }
+
+  return pass;
+}
+
 void SelfTest ( void )
 {
   bool pass = true;
@@ -101,7 +231,7 @@ void SelfTest ( void )
   {
     HashInfo * info = & g_hashes[i];
 
-    pass &= VerificationTest(info->hash,info->hashbits,info->verification,false);
+    pass &= VerifyVariants(info,false);
   }
 
   if(!pass)
@@ -113,7 +243,8 @@ void SelfTest ( void )
       HashInfo * info = & g_hashes[i];
 
       printf("%16s - ",info->name);
-      pass &= VerificationTest(info->hash,info->hashbits,info->verification,true);
+      if(info->hash == NULL) printf("not supported on this CPU\n");
+      pass &= VerifyVariants(info,true);
     }
 
     exit(1);
@@ -128,7 +259,9 @@ void test ( hashfunc<hashtype> hash, HashInfo * info )
   const int hashbits = sizeof(hashtype) * 8;
 
   printf("-------------------------------------------------------------------------------\n");
-  printf("--- Testing %s (%s)\n\n",info->name,info->desc);
+  printf("--- Testing %s (%s)\n",info->name,info->desc);
+  if(info->variant) printf("--- Variant %s\n",info->variant);
+  printf("\n");
 
   //-----------------------------------------------------------------------------
   // Sanity tests
@@ -150,6 +283,9 @@ void test ( hashfunc<hashtype> hash, HashInfo * info )
   {
     printf("[[[ Speed Tests ]]]\n\n");
 
+    PrintTimerInfo();
+    printf("\n");
+
     BulkSpeedTest(info->hash,info->verification);
     printf("\n");
 
@@ -161,6 +297,125 @@ void test ( hashfunc<hashtype> hash, HashInfo * info )
     }
 
     printf("\n");
+
+    LatencyThroughputTest(info->hash,sizeof(hashtype),info->verification);
+    printf("\n");
+
+    VariableLengthSpeedTest(info->hash,sizeof(hashtype),info->verification);
+    printf("\n");
+
+    if(RunInlinedSpeedTest(info->hash,sizeof(hashtype),info->verification)) printf("\n");
+  }
+
+  //-----------------------------------------------------------------------------
+  // The CityHashCrc family against plain CityHash128 on long keys
+
+#ifdef SMHASHER_CITY_CRC
+  if((g_testSpeed || g_testAll) &&
+     ((info->hash == CityHashCrc128_test) || (info->hash == CityHashCrc128WithSeed_test) || (info->hash == CityHashCrc256_test)))
+  {
+    printf("[[[ City Comparison Tests ]]]\n\n");
+
+    BulkCompareTest(info->hash,CityHash128_test,"City128",info->verification);
+    printf("\n");
+  }
+#endif
+
+  //-----------------------------------------------------------------------------
+  // Incremental hashing, for the hashes that have an incremental interface
+
+  if((g_testSpeed || g_testAll) &&
+     ((info->hash == SpookyHash32_test) || (info->hash == SpookyHash64_test) || (info->hash == SpookyHash128_test)))
+  {
+    printf("[[[ Streaming Tests ]]]\n\n");
+
+    bool result = SpookyStreamingTest(info->verification);
+
+    if(!result) printf("*********FAIL*********\n");
+    printf("\n");
+  }
+
+  //-----------------------------------------------------------------------------
+  // Many keys per call, for the hashes that have a multi-buffer version
+
+  if((g_testSpeed || g_testAll) && (info->hash == MurmurHash3_x86_32))
+  {
+    printf("[[[ Batch Tests ]]]\n\n");
+
+    bool result = BatchSpeedTest(info->verification);
+
+    if(!result) printf("*********FAIL*********\n");
+    printf("\n");
+  }
+
+  //-----------------------------------------------------------------------------
+  // Small keys at every offset within a cache line
+
+  if(g_testAlignment || g_testAll)
+  {
+    printf("[[[ Alignment Tests ]]]\n\n");
+
+    AlignmentSpeedTest(info->hash,info->verification);
+    printf("\n");
+  }
+
+  //-----------------------------------------------------------------------------
+  // Cold-cache latency. Evicting the whole cache hierarchy before every call
+  // is slow, so it's not part of g_testAll.
+
+  if(g_testColdCache)
+  {
+    printf("[[[ Cold Cache Tests ]]]\n\n");
+
+    ColdSpeedTest(info->hash,sizeof(hashtype),info->verification);
+    printf("\n");
+  }
+
+  //-----------------------------------------------------------------------------
+  // Key size sweep from 1 byte to 256 megs. Slow and memory-hungry, so it's
+  // not part of g_testAll.
+
+  if(g_testSpeedSweep)
+  {
+    printf("[[[ Speed Sweep Tests ]]]\n\n");
+
+    SweepSpeedTest(info->hash,info->verification);
+    printf("\n");
+  }
+
+  //-----------------------------------------------------------------------------
+  // Bulk hashing on 1..N threads at once. Takes over every CPU in the box, so
+  // it's not part of g_testAll either.
+
+  if(g_testScaling)
+  {
+    printf("[[[ Thread Scaling Tests ]]]\n\n");
+
+    ScalingSpeedTest(info->hash,info->verification);
+    printf("\n");
+  }
+
+  //-----------------------------------------------------------------------------
+  // Real hash tables keyed through the hash. The largest tables are several
+  // times the size of the last-level cache, so it's not part of g_testAll.
+
+  if(g_testHashTable)
+  {
+    printf("[[[ Hash Table Tests ]]]\n\n");
+
+    HashTableTest(info->hash,info->verification);
+    printf("\n");
+  }
+
+  //-----------------------------------------------------------------------------
+  // Replay of a captured key trace, if one was given with --trace=FILE
+
+  if(g_traceFile)
+  {
+    printf("[[[ Trace Replay Tests ]]]\n\n");
+
+    TraceSpeedTest(info->hash,sizeof(hashtype),info->verification);
+    printf("\n");
   }
 
   //-----------------------------------------------------------------------------
@@ -517,10 +772,18 @@ void testHash ( const char * name )
     printf("Invalid hash '%s' specified\n",name);
     return;
   }
+  else if(pInfo->hash == NULL)
+  {
+    printf("Hash '%s' needs CPU features this machine doesn't have\n",name);
+    return;
+  }
   else
   {
     g_hashUnderTest = pInfo;
 
+    BaselineSetHash(pInfo->name);
+    ResultsSetHash(pInfo->name,pInfo->variant);
+
     if(pInfo->hashbits == 32)
     {
       test<uint32_t>( VerifyHash, pInfo );
@@ -545,22 +808,96 @@ void testHash ( const char * name )
 }
 //-----------------------------------------------------------------------------
 
+static void PrintUsage ( void )
+{
+  printf("Usage: SMHasher [--cpu=N] [--strict] [--lengths=FILE] [--trace=FILE]\n"
+         "                [--save-baseline=FILE] [--baseline=FILE] [--results=FILE] [hash]\n");
+}
+
 int main ( int argc, char ** argv )
 {
-  const char * hashToTest = "murmur3a";
+  const char * hashToTest = NULL;
 
-  if(argc < 2)
+  for(int i = 1; i < argc; i++)
   {
-    printf("(No test hash given on command line, testing Murmur3_x86_32.)\n");
+    if(strncmp(argv[i],"--cpu=",6) == 0)
+    {
+      char * end;
+      long cpu = strtol(argv[i] + 6,&end,10);
+
+      if(end == argv[i] + 6 || *end != 0 || cpu < 0 || cpu >= AffinityLimit())
+      {
+        printf("Invalid cpu '%s' - expected 0 to %d\n",argv[i] + 6,AffinityLimit() - 1);
+        PrintUsage();
+        return 1;
+      }
+
+      g_benchCPU = int(cpu);
+    }
+    else if(strcmp(argv[i],"--strict") == 0)
+    {
+      g_strictEnvironment = true;
+    }
+    else if(strncmp(argv[i],"--lengths=",10) == 0)
+    {
+      g_lengthFile = argv[i] + 10;
+    }
+    else if(strncmp(argv[i],"--trace=",8) == 0)
+    {
+      g_traceFile = argv[i] + 8;
+    }
+    else if(strncmp(argv[i],"--save-baseline=",16) == 0)
+    {
+      g_baselineSave = argv[i] + 16;
+    }
+    else if(strncmp(argv[i],"--baseline=",11) == 0)
+    {
+      g_baselineFile = argv[i] + 11;
+    }
+    else if(strncmp(argv[i],"--results=",10) == 0)
+    {
+      g_resultsFile = argv[i] + 10;
+    }
+    else if(argv[i][0] == '-')
+    {
+      printf("Unknown option '%s'\n",argv[i]);
+      PrintUsage();
+      return 1;
+    }
+    else
+    {
+      hashToTest = argv[i];
+    }
   }
-  else
+
+  if(hashToTest == NULL)
   {
-    hashToTest = argv[1];
+    printf("(No test hash given on command line, testing Murmur3_x86_32.)\n");
+    hashToTest = "murmur3a";
   }
 
   // Code runs on the 3rd CPU by default
 
-  SetAffinity((1 << 2));
+  bool pinned = SetAffinity(g_benchCPU);
+
+  ReadEnvironment(g_benchCPU,pinned,g_environment);
+
+  PrintEnvironment(g_environment);
+
+  char features[128];
+  printf("Features - %s\n",CPUFeatureNames(GetCPUFeatures(),features,sizeof(features)));
+
+  if(CheckEnvironment(g_environment) && g_strictEnvironment)
+  {
+    printf("Refusing to run in a noisy environment (--strict)\n");
+    return 1;
+  }
+
+  printf("\n");
+
+  if(g_resultsFile && !ResultsOpen(g_resultsFile)) return 1;
+
+  BindHashes();
 
   SelfTest();
 
@@ -570,6 +907,11 @@ int main ( int argc, char ** argv )
 
   //g_testSanity = true;
   //g_testSpeed = true;
+  //g_testSpeedSweep = true;
+  //g_testAlignment = true;
+  //g_testColdCache = true;
+  //g_testHashTable = true;
+  //g_testScaling = true;
   //g_testAvalanche = true;
   //g_testBIC = true;
   //g_testCyclic = true;
@@ -581,15 +923,41 @@ int main ( int argc, char ** argv )
   //g_testWindow = true;
   //g_testZeroes = true;
 
+  //g_speedCounters = true;
+  //g_speedEnergy = true;
+  //g_speedPrecision = 0.002;
+
   testHash(hashToTest);
 
   //----------
 
+  int status = 0;
+
+  if(g_baselineFile)
+  {
+    printf("\n[[[ Speed Regression Check ]]]\n\n");
+
+    int slowdowns = BaselineCompare(g_baselineFile);
+
+    if(slowdowns != 0) status = 1;
+  }
+
+  if(g_baselineSave)
+  {
+    printf("\n");
+
+    if(!BaselineSave(g_baselineSave)) status = 1;
+  }
+
+  ResultsClose();
+
+  //----------
+
   int timeEnd = clock();
 
   printf("\n");
   printf("Input vcode 0x%08x, Output vcode 0x%08x, Result vcode 0x%08x\n",g_inputVCode,g_outputVCode,g_resultVCode);
   printf("Verification value is 0x%08x - Testing took %f seconds\n",g_verify,double(timeEnd-timeBegin)/double(CLOCKS_PER_SEC));
   printf("-------------------------------------------------------------------------------\n");
-  return 0;
+  return status;
 }
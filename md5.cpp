@@ -319,6 +319,12 @@ static const unsigned char md5_padding[64] =
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
+const void * md5_table ( size_t & size )
+{
+    size = sizeof(md5_padding);
+    return md5_padding;
+}
+
 /*
  * MD5 final digest
  */